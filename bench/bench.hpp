@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// do_not_optimize keeps the compiler from discarding a benchmarked result.
+template<class T>
+inline void do_not_optimize(const T& v)
+{
+  asm volatile("" : : "r,m"(v) : "memory");
+}
+
+// run calls fn(i) for i in [0, iterations) and prints the time per call.
+template<class Fn>
+void run(const std::string& name, size_t iterations, Fn&& fn)
+{
+  // warm up caches and branch predictors
+  for (size_t i = 0; i < iterations / 10; i++)
+    fn(i);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++)
+    fn(i);
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  std::cout << std::left << std::setw(32) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << ns / iterations
+            << " ns/op" << std::endl;
+}
+#endif
@@ -0,0 +1,139 @@
+#include <bench.hpp>
+#include <binance/conv.hpp>
+#include <charconv>
+#include <random>
+#include <vector>
+
+struct sample
+{
+  size_t offset;
+  size_t size;
+};
+
+// builds n integers with the given amount of digits, stored back to back in
+// a single buffer that is padded like a simdjson string buffer.
+std::vector<sample> make_samples(std::string& buf, size_t n, int digits,
+                                 bool negative)
+{
+  std::mt19937_64 rng(digits);
+  std::vector<sample> samples;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    std::string s = negative ? "-" : "";
+    s += char('1' + rng() % 9);
+    for (int d = 1; d < digits; d++)
+      s += char('0' + rng() % 10);
+
+    samples.push_back({buf.size(), s.size()});
+    buf += s;
+  }
+  buf.append(simdjson::SIMDJSON_PADDING, '\0');
+
+  return samples;
+}
+
+int bench_parse_int(size_t iterations)
+{
+  for (int digits : {6, 13, 16, 19})
+  {
+    for (bool negative : {false, true})
+    {
+      std::string buf;
+      auto samples  = make_samples(buf, 1024, digits, negative);
+      const char* p = buf.data();
+
+      std::cout << "-- parse_int, " << digits << " digits"
+                << (negative ? ", negative" : "") << std::endl;
+
+      run("std::from_chars", iterations, [&](size_t i) {
+        auto& s   = samples[i & 1023];
+        int64_t v = 0;
+        std::from_chars(p + s.offset, p + s.offset + s.size, v);
+        do_not_optimize(v);
+      });
+
+      for (int isa = 0; isa <= int(binance::cpu::detect()); isa++)
+      {
+        auto& k          = binance::conv::kernels_for(binance::cpu::isa(isa));
+        std::string name = binance::cpu::to_string(k.isa);
+
+        // make sure every path agrees before timing them
+        for (auto& s : samples)
+        {
+          int64_t v = binance::conv::scalar::parse_int(p + s.offset, s.size);
+          if (v != k.parse_int(p + s.offset, s.size)
+              || v != k.parse_int_padded(p + s.offset, s.size))
+          {
+            std::cerr << name << ": mismatch parsing "
+                      << std::string(p + s.offset, s.size) << std::endl;
+            return 1;
+          }
+        }
+
+        run(name + "::parse_int", iterations, [&](size_t i) {
+          auto& s = samples[i & 1023];
+          do_not_optimize(k.parse_int(p + s.offset, s.size));
+        });
+        run(name + "::parse_int_padded", iterations, [&](size_t i) {
+          auto& s = samples[i & 1023];
+          do_not_optimize(k.parse_int_padded(p + s.offset, s.size));
+        });
+      }
+    }
+  }
+
+  return 0;
+}
+
+int bench_hex_encode(size_t iterations)
+{
+  // 32 bytes is the size of a HMAC-SHA256 digest
+  for (size_t size : {32, 256})
+  {
+    std::mt19937_64 rng(size);
+    std::vector<unsigned char> data(size);
+    for (auto& c : data)
+      c = (unsigned char) rng();
+
+    std::string expected(size * 2, '\0');
+    binance::conv::scalar::hex_encode(&data[0], size, &expected[0]);
+
+    std::cout << "-- hex_encode, " << size << " bytes" << std::endl;
+
+    for (int isa = 0; isa <= int(binance::cpu::detect()); isa++)
+    {
+      auto& k          = binance::conv::kernels_for(binance::cpu::isa(isa));
+      std::string name = binance::cpu::to_string(k.isa);
+      std::string out(size * 2, '\0');
+
+      k.hex_encode(&data[0], size, &out[0]);
+      if (out != expected)
+      {
+        std::cerr << name << ": hex_encode mismatch" << std::endl;
+        return 1;
+      }
+
+      run(name + "::hex_encode", iterations / 4, [&](size_t) {
+        k.hex_encode(&data[0], size, &out[0]);
+        do_not_optimize(out[0]);
+      });
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+  std::cout << "Host ISA: " << binance::cpu::to_string(binance::cpu::detect())
+            << ", using: "
+            << binance::cpu::to_string(binance::conv::active_kernels().isa)
+            << std::endl;
+
+  if (bench_parse_int(iterations) != 0)
+    return 1;
+  return bench_hex_encode(iterations);
+}
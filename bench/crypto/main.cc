@@ -0,0 +1,107 @@
+#include <bench.hpp>
+#include <binance/crypto/signer.hpp>
+#include <binance/http/order_template.hpp>
+#include <string>
+
+// a place_order query as signed by http::stream.
+const std::string query =
+    "symbol=BTCUSDT&side=BUY&type=LIMIT&timeInForce=GTC&quantity=0.001"
+    "&price=27123.40&newClientOrderId=strategy-1-000042"
+    "&timestamp=1690000000000";
+const std::string secret =
+    "NhqPtmdSJYdKjVHjA7PZj4Mge3R5YNiP1e3UZjInClVN65XAbvqqM6A7H5fATj0j";
+
+// hmac_ctx signs like signer did before keeping the key schedule: a new
+// HMAC_CTX keyed for every signature.
+std::string hmac_ctx(const std::string& key, const std::string& msg)
+{
+  ::HMAC_CTX* ctx = ::HMAC_CTX_new();
+  ::HMAC_Init_ex(ctx, key.data(), int(key.size()), ::EVP_sha256(), nullptr);
+  ::HMAC_Update(ctx, (const unsigned char*) msg.data(), msg.size());
+
+  unsigned char hash[EVP_MAX_MD_SIZE];
+  unsigned int size;
+  ::HMAC_Final(ctx, hash, &size);
+  ::HMAC_CTX_free(ctx);
+
+  std::string out(size * 2, '\0');
+  binance::conv::scalar::hex_encode(hash, size, &out[0]);
+  return out;
+}
+
+int main(int argc, char* argv[])
+{
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+  binance::crypto::signer s(secret);
+  char sig[binance::crypto::signer::hex_size];
+
+  // make sure both agree before timing them
+  std::string expected = hmac_ctx(secret, query);
+  s.sign(query, sig);
+  if (expected != std::string(sig, sizeof(sig)))
+  {
+    std::cerr << "signer: mismatch signing " << query << std::endl;
+    return 1;
+  }
+
+  std::cout << "-- HMAC-SHA256, " << query.size() << " bytes" << std::endl;
+
+  run("HMAC_CTX per signature", iterations,
+      [&](size_t) { do_not_optimize(hmac_ctx(secret, query)); });
+
+  run("signer per signature", iterations, [&](size_t) {
+    binance::crypto::signer ss(secret);
+    ss.sign(query, sig);
+    do_not_optimize(sig[0]);
+  });
+
+  run("signer::sign", iterations, [&](size_t) {
+    s.sign(query, sig);
+    do_not_optimize(sig[0]);
+  });
+
+  // the same query, with its shared arguments hashed once.
+  binance::http::query_args shared{{"symbol", "BTCUSDT"},
+                                   {"side", "BUY"},
+                                   {"type", "LIMIT"},
+                                   {"timeInForce", "GTC"}};
+  binance::http::query_args args{{"quantity", 0.001, 3},
+                                 {"price", 27123.4, 2},
+                                 {"newClientOrderId", "strategy-1-000042"},
+                                 {"timestamp", int64_t(1690000000000)}};
+  binance::http::order_template t(s, shared);
+  std::string out;
+
+  t.write(out, args);
+  if (out != query + "&signature=" + expected)
+  {
+    std::cerr << "order_template: mismatch writing " << out << std::endl;
+    return 1;
+  }
+
+  binance::http::query_args all(shared);
+  all.insert_kv({"quantity", 0.001, 3});
+  all.insert_kv({"price", 27123.4, 2});
+  all.insert_kv({"newClientOrderId", "strategy-1-000042"});
+  all.insert_kv({"timestamp", int64_t(1690000000000)});
+  std::string path;
+
+  run("append_to + signer::sign", iterations, [&](size_t) {
+    out.clear();
+    all.append_to(path, out);
+    size_t n = out.size();
+    out += "&signature=";
+    out.resize(out.size() + binance::crypto::signer::hex_size);
+    s.sign(std::string_view(out.data(), n),
+           &out[out.size() - binance::crypto::signer::hex_size]);
+    do_not_optimize(out[0]);
+  });
+
+  run("order_template::write", iterations, [&](size_t) {
+    t.write(out, args);
+    do_not_optimize(out[0]);
+  });
+
+  return 0;
+}
@@ -1,5 +1,4 @@
 #include <binance.hpp>
-#include <boost/algorithm/string.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/program_options.hpp>
 #include <chrono>
@@ -226,7 +225,7 @@ private:
     const binance::json::object& jb = parser_.parse(buffer_).root();
     if (jb["e"].get(e) == simdjson::SUCCESS && e == "depthUpdate")
     {
-      binance::websocket::messages::book_depth bd;
+      binance::websocket::messages::book_depth_header bd;
       bd = jb;
 
       int64_t ts = bd.event_time.time_since_epoch().count() / 1000000;
@@ -234,27 +233,31 @@ private:
         return;
       last_time_ = ts;
 
-      handle_depth(&bd);
+      handle_depth(jb, &bd);
     }
 
     read();
   }
 
-  void handle_depth(binance::websocket::messages::book_depth* bd)
+  // the levels are decoded straight from the parser, without going through
+  // book_depth's vectors.
+  void handle_depth(const binance::json::object& jb,
+                    binance::websocket::messages::book_depth_header* bd)
   {
+    using binance::websocket::messages::book_depth_header;
+    using binance::websocket::messages::price_point;
+
     if (final_id_ == 0)
     {
       queued_message qm(bd->last_final_id, bd->final_id);
 
-      for (auto& ask : bd->asks)
-      {
+      book_depth_header::for_each_ask(jb, [&](const price_point& ask) {
         qm.asks.emplace_back(ask.price, ask.qty);
-      }
+      });
 
-      for (auto& bid : bd->bids)
-      {
+      book_depth_header::for_each_bid(jb, [&](const price_point& bid) {
         qm.bids.emplace_back(bid.price, bid.qty);
-      }
+      });
 
       queued_messages_.push_back(qm);
 
@@ -269,10 +272,10 @@ private:
     }
     final_id_ = bd->final_id;
 
-    for (auto& v : bd->asks)
-      handle_book_event(data_.asks, v);
-    for (auto& v : bd->bids)
-      handle_book_event(data_.bids, v);
+    book_depth_header::for_each_ask(
+        jb, [&](const price_point& v) { handle_book_event(data_.asks, v); });
+    book_depth_header::for_each_bid(
+        jb, [&](const price_point& v) { handle_book_event(data_.bids, v); });
 
     std::cout << "Spread: "
               << data_.asks.rbegin()->first - data_.bids.rbegin()->first << "\r"
@@ -337,17 +340,17 @@ int main(int argc, char* argv[])
 
   std::string symbol = args["symbol"].as<std::string>();
   int precision      = 0;
+  binance::symbol_registry symbols;
   try
   {
     api.async_read<binance::http::messages::exchange_info>([&](auto* exi) {
-      for (auto& v : exi->symbols)
-      {
-        if (boost::iequals(symbol, v.symbol))
-        {
-          precision = v.price_precision;
-          break;
-        }
-      }
+      // ids follow the order of exi->symbols
+      symbols = binance::symbol_registry(exi->symbols);
+      symbols.install();
+
+      binance::symbol_id id = symbols.find_any_case(symbol);
+      if (id != binance::invalid_symbol)
+        precision = exi->symbols[id].price_precision;
     });
 
     api.async_read<binance::http::messages::listen_key>([&](auto* v) {
@@ -32,7 +32,6 @@ public:
       : api_(api)
       , kd_("btcusdt", "1h")
   {
-    api_.set_rate_limit(1000, 60);
     kd_.set_limit(1500);
   }
   ~downloader()
@@ -99,17 +98,13 @@ int main(int argc, char* argv[])
 
   std::cout << "Connecting to " << args["url"].as<std::string>() << std::endl;
 
+  api.set_error_handler([](const binance::error& ec) {
+    std::cout << "binance error: " << ec << std::endl;
+  });
   api.async_connect();
   std::make_shared<downloader>(api)->run();
 
-  try
-  {
-    ioc.run();
-  }
-  catch (const binance::error& ec)
-  {
-    std::cout << "binance error: " << ec << std::endl;
-  }
+  ioc.run();
 
   return 0;
 }
@@ -46,23 +46,23 @@ int main(int argc, char* argv[])
 
   api.async_connect();
   auto kd = new binance::http::messages::kline_data("btcusdt", "1m");
-  api.async_read(kd, [&api](auto* kd) {
-    for (auto& k : kd->klines)
-    {
-      std::cout << "open: " << k.open << std::endl;
-    }
-    delete kd;
-    api.close();
-  });
+  api.async_read(
+      kd,
+      [&api](auto* kd) {
+        for (auto& k : kd->klines)
+        {
+          std::cout << "open: " << k.open << std::endl;
+        }
+        delete kd;
+        api.close();
+      },
+      [&api, kd](const binance::error& ec) {
+        std::cout << "binance error: " << ec << std::endl;
+        delete kd;
+        api.close();
+      });
 
-  try
-  {
-    ioc.run();
-  }
-  catch (const binance::error& ec)
-  {
-    std::cout << "binance error: " << ec << std::endl;
-  }
+  ioc.run();
 
   return 0;
 }
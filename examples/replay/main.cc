@@ -0,0 +1,71 @@
+#include <binance.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <map>
+
+void parse_args(int argc, char* argv[],
+                boost::program_options::options_description& desc,
+                boost::program_options::variables_map& vm)
+{
+  namespace opt = boost::program_options;
+
+  desc.add_options()("help,h", "Help message")(
+      "file,f", opt::value<std::string>(),
+      "Recorded frames, one JSON document per line")(
+      "batch,b", opt::value<size_t>()->default_value(1 << 20),
+      "Batch size in bytes, larger than the biggest frame");
+
+  opt::store(opt::parse_command_line(argc, argv, desc), vm);
+  opt::notify(vm);
+}
+
+// replays a file of recorded websocket frames and prints how many frames of
+// every event type it has, along with the best bid of the last book ticker.
+int main(int argc, char* argv[])
+{
+  boost::program_options::variables_map args;
+  boost::program_options::options_description desc(argv[0]);
+
+  parse_args(argc, argv, desc, args);
+  if (args.count("help") || !args.count("file"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  binance::json::parser parser;
+  binance::websocket::messages::book_ticker bt{};
+  std::map<std::string, size_t> events;
+
+  auto start = std::chrono::steady_clock::now();
+  size_t n   = parser.load_many(
+      args["file"].as<std::string>(),
+      [&](const binance::json::value& v) {
+        // combined streams wrap the payload in "data"
+        binance::json::object jb = v;
+        binance::json::object data;
+        if (jb["data"].get(data) == simdjson::SUCCESS)
+          jb = data;
+
+        std::string_view e;
+        if (jb["e"].get(e) != simdjson::SUCCESS)
+          return;
+        events[std::string(e)]++;
+
+        if (e == "bookTicker")
+          bt = jb;
+      },
+      args["batch"].as<size_t>());
+  auto took = std::chrono::steady_clock::now() - start;
+
+  for (auto& [e, count] : events)
+    std::cout << e << ": " << count << std::endl;
+  std::cout << "Last best bid: " << bt.best_bid_price << std::endl;
+  std::cout << n << " frames in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(took)
+                   .count()
+            << "ms" << std::endl;
+
+  return 0;
+}
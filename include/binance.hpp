@@ -1,11 +1,14 @@
 #ifndef BINANCE_HPP
 #define BINANCE_HPP
 
+#include <binance/arena.hpp>
 #include <binance/definitions.hpp>
 #include <binance/http/stream.hpp>
 #include <binance/websocket/messages.hpp>
+#include <binance/websocket/peek.hpp>
 #include <binance/websocket/stream.hpp>
 #include <binance/websocket/subscribe_to.hpp>
 #include <binance/websocket/unsubscribe_from.hpp>
+#include <binance/wire.hpp>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+#ifndef BINANCE_ARENA_HPP
+#define BINANCE_ARENA_HPP
+
+#include <binance/common.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace binance
+{
+namespace detail
+{
+template<class T, class = void>
+struct has_visit_strings : std::false_type
+{
+};
+
+template<class T>
+struct has_visit_strings<
+    T, std::void_t<decltype(std::declval<T&>().visit_strings(
+           std::declval<void (*)(std::string_view&)>()))>> : std::true_type
+{
+};
+}  // namespace detail
+
+// arena_span is a range of snapshotted elements living in an arena.
+template<class T>
+struct arena_span
+{
+  T* data;
+  std::size_t size;
+
+  T* begin() const
+  {
+    return data;
+  }
+  T* end() const
+  {
+    return data + size;
+  }
+  T& operator[](std::size_t i) const
+  {
+    return data[i];
+  }
+};
+
+// arena is a bump allocator used to snapshot decoded messages.
+//
+// Messages hold string_views pointing into the json::parser, which the next
+// parse() overwrites. arena::snapshot copies a message into the arena and the
+// bytes of its strings right after it, so it can be queued or handed to
+// another component. Everything is released at once with reset().
+//
+// Messages holding vectors (book_depth...) are copy constructed, so the
+// elements of the vectors live on the heap until reset().
+class arena
+{
+  struct block
+  {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+  };
+
+  // destructors to run on reset(), for the messages holding vectors
+  struct dtor
+  {
+    void (*destroy)(void*, std::size_t);
+    void* data;
+    std::size_t size;
+  };
+
+  std::vector<block> blocks_;
+  std::vector<dtor> dtors_;
+  std::size_t current_;
+  char* ptr_;
+  char* end_;
+  std::size_t block_size_;
+
+public:
+  explicit arena(std::size_t block_size = 64 * 1024)
+      : current_(0)
+      , ptr_(nullptr)
+      , end_(nullptr)
+      , block_size_(block_size)
+  {
+  }
+  arena(const arena&) = delete;
+  arena(arena&& o) noexcept
+      : blocks_(std::move(o.blocks_))
+      , dtors_(std::move(o.dtors_))
+      , current_(o.current_)
+      , ptr_(std::exchange(o.ptr_, nullptr))
+      , end_(std::exchange(o.end_, nullptr))
+      , block_size_(o.block_size_)
+  {
+    o.blocks_.clear();
+    o.dtors_.clear();
+    o.current_ = 0;
+  }
+  arena& operator=(const arena&) = delete;
+  arena& operator=(arena&& o) noexcept
+  {
+    if (this != &o)
+    {
+      destroy();
+      blocks_     = std::move(o.blocks_);
+      dtors_      = std::move(o.dtors_);
+      current_    = std::exchange(o.current_, 0);
+      ptr_        = std::exchange(o.ptr_, nullptr);
+      end_        = std::exchange(o.end_, nullptr);
+      block_size_ = o.block_size_;
+      o.blocks_.clear();
+      o.dtors_.clear();
+    }
+    return *this;
+  }
+  ~arena()
+  {
+    destroy();
+  }
+
+  // allocate returns n bytes aligned to align. Throws std::bad_alloc.
+  really_inline void* allocate(std::size_t n, std::size_t align)
+  {
+    char* p = align_up(ptr_, align);
+    if (ptr_ == nullptr || p + n > end_)
+    {
+      next_block(n + align);
+      p = align_up(ptr_, align);
+    }
+    ptr_ = p + n;
+    return p;
+  }
+
+  // reset releases every snapshot at once. The blocks are kept for reuse.
+  void reset()
+  {
+    destroy();
+    if (!blocks_.empty())
+      use_block(0);
+  }
+
+  // capacity returns the bytes held by the arena.
+  std::size_t capacity() const
+  {
+    std::size_t n = 0;
+    for (auto& b : blocks_)
+      n += b.size;
+    return n;
+  }
+
+  // snapshot copies v, and the strings it references, into the arena.
+  template<class T>
+  T* snapshot(const T& v)
+  {
+    return snapshot(&v, 1);
+  }
+
+  template<class T>
+  arena_span<T> snapshot(const std::vector<T>& v)
+  {
+    return {snapshot(v.data(), v.size()), v.size()};
+  }
+
+  template<class T>
+  T* snapshot(const T* v, std::size_t n)
+  {
+    static_assert(detail::has_visit_strings<T>::value,
+                  "arena::snapshot needs a message declared with "
+                  "BINANCE_SCHEMA, so its strings can be copied");
+    static_assert(std::is_copy_constructible_v<T>,
+                  "arena::snapshot needs a copyable message");
+
+    T* dst = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+    if constexpr (std::is_trivially_copyable_v<T>)
+      std::memcpy(dst, v, sizeof(T) * n);
+    else
+    {
+      std::uninitialized_copy(v, v + n, dst);
+      if constexpr (!std::is_trivially_destructible_v<T>)
+        dtors_.push_back({&destroy_n<T>, dst, n});
+    }
+
+    std::size_t strings = 0;
+    for (std::size_t i = 0; i < n; i++)
+      dst[i].visit_strings([&](std::string_view& s) { strings += s.size(); });
+    if (strings == 0)
+      return dst;
+
+    char* str = static_cast<char*>(allocate(strings, 1));
+    for (std::size_t i = 0; i < n; i++)
+    {
+      dst[i].visit_strings([&](std::string_view& s) {
+        if (s.empty())
+          return;
+        std::memcpy(str, s.data(), s.size());
+        s = std::string_view(str, s.size());
+        str += s.size();
+      });
+    }
+
+    return dst;
+  }
+
+private:
+  template<class T>
+  static void destroy_n(void* p, std::size_t n)
+  {
+    std::destroy_n(static_cast<T*>(p), n);
+  }
+
+  void destroy()
+  {
+    for (auto it = dtors_.rbegin(); it != dtors_.rend(); it++)
+      it->destroy(it->data, it->size);
+    dtors_.clear();
+  }
+
+  static really_inline char* align_up(char* p, std::size_t align)
+  {
+    auto v = reinterpret_cast<std::uintptr_t>(p);
+    return reinterpret_cast<char*>((v + align - 1) & ~(align - 1));
+  }
+
+  void use_block(std::size_t i)
+  {
+    current_ = i;
+    ptr_     = blocks_[i].data.get();
+    end_     = ptr_ + blocks_[i].size;
+  }
+
+  void next_block(std::size_t n)
+  {
+    // reuse the blocks kept by reset() when they are big enough
+    for (std::size_t i = blocks_.empty() ? 0 : current_ + 1; i < blocks_.size();
+         i++)
+    {
+      if (blocks_[i].size >= n)
+        return use_block(i);
+    }
+
+    std::size_t size = std::max(block_size_, n);
+    blocks_.push_back({std::unique_ptr<char[]>(new char[size]), size});
+    use_block(blocks_.size() - 1);
+  }
+};
+}  // namespace binance
+
+#endif
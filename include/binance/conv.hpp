@@ -1,10 +1,11 @@
 #ifndef BINANCE_CONV_HPP
 #define BINANCE_CONV_HPP
 
-#include <immintrin.h>
-
 #include <binance/common.hpp>
+#include <binance/cpu.hpp>
 #include <binance/error.hpp>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
 
@@ -12,46 +13,469 @@ namespace binance
 {
 namespace conv
 {
-really_inline int64_t parse_int(const char* s, std::size_t remaining)
+namespace detail
 {
-  int64_t val = 0;
-  while (remaining >= 8)
+// int64_t holds at most 19 decimal digits.
+constexpr std::size_t max_int_digits = 19;
+
+static const unsigned char __hex_chars[16] = {'0', '1', '2', '3', '4', '5',
+                                              '6', '7', '8', '9', 'a', 'b',
+                                              'c', 'd', 'e', 'f'};
+#ifdef BINANCE_X86
+static const unsigned char __blend_table[32] = {
+    0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128,
+    0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128};
+static const unsigned char __dup_index[16] = {0, 0, 1, 1, 2, 2, 3, 3,
+                                              4, 4, 5, 5, 6, 6, 7, 7};
+// __hex_chars in every 128-bit lane of a 512-bit register.
+alignas(64) static const unsigned char __hex_chars4[64] = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c',
+    'd', 'e', 'f', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+    'a', 'b', 'c', 'd', 'e', 'f', '0', '1', '2', '3', '4', '5', '6',
+    '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f', '0', '1', '2', '3',
+    '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+// Sliding window for right-aligning up to 16 bytes with pshufb. Loading 16
+// bytes at &__shift_table[n] produces a mask that moves the first n bytes to
+// the end of the register and zeroes the rest.
+alignas(16) static const char __shift_table[32] = {
+    -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,
+    -128, -128, -128, -128, -128, 0,    1,    2,    3,    4,    5,
+    6,    7,    8,    9,    10,   11,   12,   13,   14,   15};
+#endif
+
+really_inline bool parse_sign(const char*& s, std::size_t& len)
+{
+  bool neg = false;
+  if (len > 0 && (*s == '-' || *s == '+'))
   {
-    // Broadcast 8-bit integer a to all elements of dst.
-    __m128i ascii0 = _mm_set1_epi8('0');
-    // Set packed 8-bit integers in dst with the supplied values in reverse
-    // order.
-    __m128i mul_1_10 =
-        _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
-    // Set packed 16-bit integers in dst with the supplied values in reverse
-    // order.
-    __m128i mul_1_100 = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
-    // Set packed 16-bit integers in dst with the supplied values in reverse
-    // order.
-    __m128i mul_1_10000 =
-        _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
-    __m128i in = _mm_sub_epi8(_mm_loadu_si128((__m128i*) s), ascii0);
-    // Vertically multiply each unsigned 8-bit integer from a with the
-    // corresponding signed 8-bit integer from b
-    __m128i t1 = _mm_maddubs_epi16(in, mul_1_10);
-    // Multiply packed signed 16-bit integers in a and b, producing intermediate
-    // signed 32-bit integers
-    __m128i t2 = _mm_madd_epi16(t1, mul_1_100);
-    // Convert packed signed 32-bit integers from a and b to packed 16-bit
-    // integers using unsigned saturation
-    __m128i t3 = _mm_packus_epi32(t2, t2);
-    // Multiply packed signed 16-bit integers in a and b, producing intermediate
-    // signed 32-bit integers.
-    __m128i t4 = _mm_madd_epi16(t3, mul_1_10000);
-    // Copy the lower 32-bit integer in a to dst.
-    val = val * 100000000 + _mm_cvtsi128_si32(t4);
-    remaining -= 8;
-    s += 8;
+    neg = *s == '-';
+    s++;
+    len--;
   }
-  while (remaining-- > 0)
+  return neg;
+}
+}  // namespace detail
+
+// Every kernel comes in a scalar, SSE4.2, AVX2 and AVX-512 flavour. The one
+// used by conv::parse_int & co. is picked once, on first use, see
+// conv::active_kernels.
+namespace scalar
+{
+inline int64_t parse_int(const char* s, std::size_t len)
+{
+  bool neg    = detail::parse_sign(s, len);
+  int64_t val = 0;
+  while (len-- > 0)
     val = val * 10 + (*s++ - '0');
 
-  return val;
+  return neg ? -val : val;
+}
+
+inline int64_t parse_int_padded(const char* s, std::size_t len)
+{
+  return parse_int(s, len);
+}
+
+inline void hex_encode(const unsigned char* data, std::size_t size, char* out)
+{
+  for (std::size_t i = 0; i < size; i++)
+  {
+    *out++ = detail::__hex_chars[data[i] >> 4];
+    *out++ = detail::__hex_chars[data[i] & 15];
+  }
+}
+}  // namespace scalar
+
+#ifdef BINANCE_X86
+namespace sse42
+{
+// Converts 16 right-aligned digit values (0-9) into an integer.
+BINANCE_TARGET_SSE42 really_inline uint64_t digits16_to_int(__m128i in)
+{
+  const __m128i mul_1_10 =
+      _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+  const __m128i mul_1_100   = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+  const __m128i mul_1_10000 =
+      _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
+
+  // pairs of digits -> 2-digit numbers (16-bit)
+  __m128i t1 = _mm_maddubs_epi16(in, mul_1_10);
+  // pairs of 2-digit numbers -> 4-digit numbers (32-bit)
+  __m128i t2 = _mm_madd_epi16(t1, mul_1_100);
+  // narrow back to 16-bit, 4-digit numbers always fit
+  __m128i t3 = _mm_packus_epi32(t2, t2);
+  // pairs of 4-digit numbers -> 8-digit numbers (32-bit)
+  __m128i t4 = _mm_madd_epi16(t3, mul_1_10000);
+
+  uint64_t v = uint64_t(_mm_cvtsi128_si64(t4));
+  return (v & 0xffffffff) * 100000000 + (v >> 32);
+}
+
+// Loads len (up to 16) bytes right-aligned into a register, zeroing the rest,
+// without touching memory outside [s, s+len).
+BINANCE_TARGET_SSE42 really_inline __m128i load_digits(const char* s,
+                                                       std::size_t len)
+{
+  uint64_t hi = 0, lo = 0;
+  if (len >= 8)
+  {
+    std::memcpy(&lo, &s[len - 8], 8);
+    if (len > 8)
+    {
+      std::memcpy(&hi, &s[0], 8);
+      hi <<= 8 * (16 - len);
+    }
+  }
+  else if (len >= 4)
+  {
+    uint32_t a, b;
+    std::memcpy(&a, &s[0], 4);
+    std::memcpy(&b, &s[len - 4], 4);
+    lo = (uint64_t(b) << 32) | (uint64_t(a) << 8 * (8 - len));
+  }
+  else
+  {
+    for (std::size_t i = 0; i < len; i++)
+      lo |= uint64_t(uint8_t(s[i])) << 8 * (8 - len + i);
+  }
+
+  return _mm_subs_epu8(_mm_set_epi64x(int64_t(lo), int64_t(hi)),
+                       _mm_set1_epi8('0'));
+}
+
+// Loads up to 16 digits relying on the buffer being padded.
+BINANCE_TARGET_SSE42 really_inline __m128i load_digits_padded(const char* s,
+                                                              std::size_t len)
+{
+  __m128i in   = _mm_sub_epi8(_mm_loadu_si128((const __m128i*) s),
+                            _mm_set1_epi8('0'));
+  __m128i mask = _mm_loadu_si128((const __m128i*) &detail::__shift_table[len]);
+  return _mm_shuffle_epi8(in, mask);
+}
+
+// parse_int never reads outside [s, s+len): short inputs are gathered with
+// overlapping 4 and 8 byte loads instead of a full 16 byte load.
+BINANCE_TARGET_SSE42 inline int64_t parse_int(const char* s, std::size_t len)
+{
+  bool neg = detail::parse_sign(s, len);
+  if (len < 4 || len > detail::max_int_digits)
+    return neg ? -scalar::parse_int(s, len) : scalar::parse_int(s, len);
+
+  uint64_t val;
+  if (len <= 16)
+    val = digits16_to_int(load_digits(s, len));
+  else
+  {
+    // the last 16 digits are in range, the leading 1-3 are gathered apart.
+    __m128i lo = _mm_subs_epu8(_mm_loadu_si128((const __m128i*) &s[len - 16]),
+                               _mm_set1_epi8('0'));
+    val = digits16_to_int(load_digits(s, len - 16)) * 10000000000000000
+          + digits16_to_int(lo);
+  }
+
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+// parse_int_padded requires at least 16 readable bytes starting at s, e.g.
+// strings living in a simdjson parser, which allows loading the digits
+// straight from memory.
+BINANCE_TARGET_SSE42 inline int64_t parse_int_padded(const char* s,
+                                                     std::size_t len)
+{
+  const char* p = s;
+  std::size_t n = len;
+  bool neg      = detail::parse_sign(p, n);
+  if (n == 0 || n > 16)
+    return parse_int(s, len);
+
+  uint64_t val = digits16_to_int(load_digits_padded(p, n));
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+BINANCE_TARGET_SSE42 inline void hex_encode(const unsigned char* data,
+                                            std::size_t size, char* out)
+{
+  const __m128i table =
+      _mm_loadu_si128((__m128i const*) &detail::__hex_chars[0]);
+  const __m128i mask =
+      _mm_loadu_si128((__m128i const*) &detail::__blend_table[0]);
+  const __m128i dup_index =
+      _mm_loadu_si128((__m128i const*) &detail::__dup_index[0]);
+  const __m128i _s = _mm_set1_epi8(15);
+
+  for (; size >= 8; data += 8, out += 16, size -= 8)
+  {
+    __m128i _r, _dh, _dl;                                 // result
+    __m128i _data = _mm_loadu_si64((void const*) data);  // read 8 bytes
+
+    _dh = _mm_srli_epi16(_data, 4);      // shift right 4 bits
+    _dh = _mm_and_si128(_dh, _s);        // remove higher bits
+    _dh = _mm_shuffle_epi8(table, _dh);  // search in table
+
+    _dl = _mm_and_si128(_data, _s);      // remove higher bits
+    _dl = _mm_shuffle_epi8(table, _dl);  // search in table
+
+    _dh = _mm_shuffle_epi8(_dh, dup_index);  // duplicate first
+    _dl = _mm_shuffle_epi8(_dl, dup_index);  // duplicate second
+
+    _r = _mm_blendv_epi8(_dh, _dl, mask);  // blend
+
+    _mm_storeu_si128((__m128i*) out, _r);  // store in out
+  }
+  scalar::hex_encode(data, size, out);
+}
+}  // namespace sse42
+
+namespace avx2
+{
+// Converts 32 right-aligned digit values (0-9) into an integer. Only the last
+// 24 digits are significant, which covers every int64_t.
+BINANCE_TARGET_AVX2 really_inline uint64_t digits32_to_int(__m256i in)
+{
+  const __m256i mul_1_10 = _mm256_setr_epi8(
+      10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10,
+      1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+  const __m256i mul_1_100 = _mm256_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1,
+                                              100, 1, 100, 1, 100, 1, 100, 1);
+  const __m256i mul_1_10000 =
+      _mm256_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1,
+                        10000, 1, 10000, 1, 10000, 1);
+
+  __m256i t1 = _mm256_maddubs_epi16(in, mul_1_10);
+  __m256i t2 = _mm256_madd_epi16(t1, mul_1_100);
+  // packus works per 128-bit lane, so each lane ends up with its own pair of
+  // 8-digit numbers.
+  __m256i t3 = _mm256_packus_epi32(t2, t2);
+  __m256i t4 = _mm256_madd_epi16(t3, mul_1_10000);
+
+  uint64_t lo = uint64_t(_mm_cvtsi128_si64(_mm256_castsi256_si128(t4)));
+  uint64_t hi = uint64_t(_mm_cvtsi128_si64(_mm256_extracti128_si256(t4, 1)));
+  return (lo >> 32) * 10000000000000000 + (hi & 0xffffffff) * 100000000
+         + (hi >> 32);
+}
+
+BINANCE_TARGET_AVX2 inline int64_t parse_int(const char* s, std::size_t len)
+{
+  bool neg = detail::parse_sign(s, len);
+  if (len < 4 || len > detail::max_int_digits)
+    return neg ? -scalar::parse_int(s, len) : scalar::parse_int(s, len);
+
+  uint64_t val;
+  if (len <= 16)
+    val = sse42::digits16_to_int(sse42::load_digits(s, len));
+  else
+  {
+    // 17-19 digits are converted in a single pass.
+    __m128i lo = _mm_subs_epu8(_mm_loadu_si128((const __m128i*) &s[len - 16]),
+                               _mm_set1_epi8('0'));
+    __m128i hi = sse42::load_digits(s, len - 16);
+    val        = digits32_to_int(_mm256_set_m128i(lo, hi));
+  }
+
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+BINANCE_TARGET_AVX2 inline int64_t parse_int_padded(const char* s,
+                                                    std::size_t len)
+{
+  const char* p = s;
+  std::size_t n = len;
+  bool neg      = detail::parse_sign(p, n);
+  if (n == 0 || n > 16)
+    return parse_int(s, len);
+
+  uint64_t val = sse42::digits16_to_int(sse42::load_digits_padded(p, n));
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+// hex_encode turns 16 bytes into 32 characters per iteration.
+BINANCE_TARGET_AVX2 inline void hex_encode(const unsigned char* data,
+                                           std::size_t size, char* out)
+{
+  const __m256i table = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((__m128i const*) &detail::__hex_chars[0]));
+  const __m128i mask = _mm_set1_epi8(15);
+
+  for (; size >= 16; data += 16, out += 32, size -= 16)
+  {
+    __m128i in = _mm_loadu_si128((__m128i const*) data);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+    __m128i lo = _mm_and_si128(in, mask);
+
+    // interleave the nibbles: hi0 lo0 hi1 lo1 ...
+    __m256i idx = _mm256_set_m128i(_mm_unpackhi_epi8(hi, lo),
+                                   _mm_unpacklo_epi8(hi, lo));
+    _mm256_storeu_si256((__m256i*) out, _mm256_shuffle_epi8(table, idx));
+  }
+  scalar::hex_encode(data, size, out);
+}
+}  // namespace avx2
+
+namespace avx512
+{
+// Loads len (up to 16) digits right-aligned. Masked loads never fault on the
+// lanes left out, so unlike sse42::load_digits no gathering is needed.
+BINANCE_TARGET_AVX512 really_inline __m128i load_digits(const char* s,
+                                                        std::size_t len)
+{
+  __m128i in   = _mm_maskz_loadu_epi8(__mmask16((1u << len) - 1), s);
+  __m128i mask = _mm_loadu_si128((const __m128i*) &detail::__shift_table[len]);
+  return _mm_subs_epu8(_mm_shuffle_epi8(in, mask), _mm_set1_epi8('0'));
+}
+
+BINANCE_TARGET_AVX512 inline int64_t parse_int(const char* s, std::size_t len)
+{
+  bool neg = detail::parse_sign(s, len);
+  if (len == 0 || len > detail::max_int_digits)
+    return neg ? -scalar::parse_int(s, len) : scalar::parse_int(s, len);
+
+  uint64_t val;
+  if (len <= 16)
+    val = sse42::digits16_to_int(load_digits(s, len));
+  else
+  {
+    __m128i lo = _mm_subs_epu8(_mm_loadu_si128((const __m128i*) &s[len - 16]),
+                               _mm_set1_epi8('0'));
+    __m128i hi = load_digits(s, len - 16);
+    val        = avx2::digits32_to_int(_mm256_set_m128i(lo, hi));
+  }
+
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+BINANCE_TARGET_AVX512 inline int64_t parse_int_padded(const char* s,
+                                                      std::size_t len)
+{
+  const char* p = s;
+  std::size_t n = len;
+  bool neg      = detail::parse_sign(p, n);
+  if (n == 0 || n > 16)
+    return parse_int(s, len);
+
+  uint64_t val = sse42::digits16_to_int(sse42::load_digits_padded(p, n));
+  return neg ? -int64_t(val) : int64_t(val);
+}
+
+// hex_encode turns 32 bytes into 64 characters per iteration, which is a
+// whole HMAC-SHA256 digest.
+//
+// The broadcast and insert intrinsics are avoided: GCC builds them on top of
+// _mm512_undefined_epi32, which warns with -Wuninitialized.
+BINANCE_TARGET_AVX512 inline void hex_encode(const unsigned char* data,
+                                             std::size_t size, char* out)
+{
+  const __m512i table =
+      _mm512_load_si512((void const*) &detail::__hex_chars4[0]);
+  // ul0 uh0 ul1 uh1, in 64-bit elements of ul (0-3) and uh (8-11).
+  const __m512i order = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+  const __m256i mask  = _mm256_set1_epi8(15);
+
+  for (; size >= 32; data += 32, out += 64, size -= 32)
+  {
+    __m256i in = _mm256_loadu_si256((__m256i const*) data);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(in, 4), mask);
+    __m256i lo = _mm256_and_si256(in, mask);
+
+    // unpack works per 128-bit lane: ul = {0-7, 16-23}, uh = {8-15, 24-31}
+    __m256i ul  = _mm256_unpacklo_epi8(hi, lo);
+    __m256i uh  = _mm256_unpackhi_epi8(hi, lo);
+    __m512i idx = _mm512_permutex2var_epi64(_mm512_castsi256_si512(ul), order,
+                                            _mm512_castsi256_si512(uh));
+
+    _mm512_storeu_si512((void*) out, _mm512_shuffle_epi8(table, idx));
+  }
+  avx2::hex_encode(data, size, out);
+}
+}  // namespace avx512
+#endif
+
+struct kernels
+{
+  cpu::isa isa;
+  int64_t (*parse_int)(const char*, std::size_t);
+  int64_t (*parse_int_padded)(const char*, std::size_t);
+  void (*hex_encode)(const unsigned char*, std::size_t, char*);
+};
+
+// kernels_for returns the kernels for the given instruction set, which must
+// be supported by the host (see cpu::detect).
+inline const kernels& kernels_for(cpu::isa v)
+{
+  static const kernels table[] = {
+      {cpu::isa::scalar, &scalar::parse_int, &scalar::parse_int_padded,
+       &scalar::hex_encode},
+#ifdef BINANCE_X86
+      {cpu::isa::sse42, &sse42::parse_int, &sse42::parse_int_padded,
+       &sse42::hex_encode},
+      {cpu::isa::avx2, &avx2::parse_int, &avx2::parse_int_padded,
+       &avx2::hex_encode},
+      {cpu::isa::avx512, &avx512::parse_int, &avx512::parse_int_padded,
+       &avx512::hex_encode},
+#endif
+  };
+  std::size_t i = std::size_t(v);
+  return table[i < sizeof(table) / sizeof(table[0]) ? i : 0];
+}
+
+namespace detail
+{
+// __active is picked on first use rather than by a dynamic initializer, so
+// parsing from the static initializers of other translation units is safe.
+inline const kernels*& __active()
+{
+  static const kernels* k = &kernels_for(cpu::best());
+  return k;
+}
+}  // namespace detail
+
+really_inline const kernels& active_kernels()
+{
+  return *detail::__active();
+}
+
+// use replaces the kernels picked at startup. Instruction sets the host does
+// not support are ignored.
+inline void use(cpu::isa v)
+{
+  if (v <= cpu::detect())
+    detail::__active() = &kernels_for(v);
+}
+
+// With BINANCE_DISABLE_SIMD_DISPATCH the kernels are chosen at compile time
+// from the -m flags and can be inlined.
+#ifdef BINANCE_DISABLE_SIMD_DISPATCH
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+namespace native = avx512;
+#elif defined(__AVX2__)
+namespace native = avx2;
+#elif defined(__SSE4_2__)
+namespace native = sse42;
+#else
+namespace native = scalar;
+#endif
+#endif
+
+// parse_int parses an optionally signed decimal integer of len bytes. It never
+// reads outside [s, s+len).
+really_inline int64_t parse_int(const char* s, std::size_t len)
+{
+#ifndef BINANCE_DISABLE_SIMD_DISPATCH
+  return active_kernels().parse_int(s, len);
+#else
+  return native::parse_int(s, len);
+#endif
+}
+
+// parse_int_padded behaves like parse_int but requires at least 16 readable
+// bytes starting at s, which saves gathering the digits.
+really_inline int64_t parse_int_padded(const char* s, std::size_t len)
+{
+#ifndef BINANCE_DISABLE_SIMD_DISPATCH
+  return active_kernels().parse_int_padded(s, len);
+#else
+  return native::parse_int_padded(s, len);
+#endif
 }
 
 really_inline int64_t parse_int(const char* s)
@@ -70,29 +494,12 @@ really_inline double parse_float(const std::string& s)
   return std::strtod(&s[0], nullptr);
 }
 
-static const unsigned char __hex_chars[16]   = {'0', '1', '2', '3', '4', '5',
-                                              '6', '7', '8', '9', 'a', 'b',
-                                              'c', 'd', 'e', 'f'};
-static const unsigned char __blend_table[32] = {
-    0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128,
-    0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128, 0, 128};
-static const unsigned char __dup_index[16] = {0, 0, 1, 1, 2, 2, 3, 3,
-                                              4, 4, 5, 5, 6, 6, 7, 7};
-
 class hex
 {
   std::string r_;
-  __m128i table_;
-  __m128i mask_;
-  __m128i dup_index_;
 
 public:
-  hex()
-  {
-    table_     = _mm_loadu_si128((__m128i const*) &__hex_chars[0]);
-    mask_      = _mm_loadu_si128((__m128i const*) &__blend_table[0]);
-    dup_index_ = _mm_loadu_si128((__m128i const*) &__dup_index[0]);
-  }
+  hex() = default;
 
   hex& clear()
   {
@@ -102,37 +509,14 @@ public:
 
   hex& encode(const unsigned char* data, size_t size)
   {
-    __m128i _s     = _mm_set1_epi8(15);
     size_t r_index = r_.size();
     r_.resize(r_.size() + size * 2);
 
-    size_t i = 0;
-    for (; size >= 8; i += 8, r_index += 16, size -= 8)
-    {
-      __m128i _r, _dh, _dl;                                    // result
-      __m128i _data = _mm_loadu_si64((void const*) &data[i]);  // read 8 bytes
-
-      _dh = _mm_srli_epi16(_data, 4);       // shift right 4 bits
-      _dh = _mm_and_si128(_dh, _s);         // remove higher bits
-      _dh = _mm_shuffle_epi8(table_, _dh);  // search in table
-
-      _dl = _mm_and_si128(_data, _s);       // remove higher bits
-      _dl = _mm_shuffle_epi8(table_, _dl);  // search in table
-
-      _dh = _mm_shuffle_epi8(_dh, dup_index_);  // duplicate first
-      _dl = _mm_shuffle_epi8(_dl, dup_index_);  // duplicate second
-
-      _r = _mm_blendv_epi8(_dh, _dl, mask_);  // blend
-
-      _mm_storeu_si128((__m128i*) &r_[r_index], _r);  // store in r_
-    }
-    while (size > 0)
-    {
-      r_[r_index++] = __hex_chars[data[i] >> 4];
-      r_[r_index++] = __hex_chars[data[i++] & 15];
-      size--;
-    }
-
+#ifndef BINANCE_DISABLE_SIMD_DISPATCH
+    active_kernels().hex_encode(data, size, &r_[r_index]);
+#else
+    native::hex_encode(data, size, &r_[r_index]);
+#endif
     return *this;
   }
   const std::string& final() const
@@ -0,0 +1,89 @@
+#ifndef BINANCE_CPU_HPP
+#define BINANCE_CPU_HPP
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BINANCE_X86 1
+#include <immintrin.h>
+#endif
+
+// Kernels are compiled for a specific instruction set through target
+// attributes, so the library itself can be built for the baseline ISA and
+// still use AVX2/AVX-512 on hosts that have them.
+#ifdef BINANCE_X86
+#define BINANCE_TARGET_SSE42 __attribute__((target("ssse3,sse4.1,sse4.2")))
+#define BINANCE_TARGET_AVX2  __attribute__((target("avx2")))
+#define BINANCE_TARGET_AVX512 \
+  __attribute__((target("avx2,avx512f,avx512bw,avx512vl")))
+#endif
+
+namespace binance
+{
+namespace cpu
+{
+enum class isa : int
+{
+  scalar = 0,
+  sse42  = 1,
+  avx2   = 2,
+  avx512 = 3,
+};
+
+inline const char* to_string(isa v)
+{
+  switch (v)
+  {
+    case isa::sse42:
+      return "sse4.2";
+    case isa::avx2:
+      return "avx2";
+    case isa::avx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+// detect returns the best instruction set supported by the host.
+inline isa detect()
+{
+#ifdef BINANCE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+      && __builtin_cpu_supports("avx512vl"))
+    return isa::avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return isa::avx2;
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3"))
+    return isa::sse42;
+#endif
+  return isa::scalar;
+}
+
+// best returns the instruction set the kernels run with by default.
+//
+// It is detected once and can be lowered (never raised above what the host
+// supports) with the BINANCE_ISA environment variable, e.g. BINANCE_ISA=avx2.
+inline isa best()
+{
+  static const isa v = [] {
+    isa host       = detect();
+    const char* ev = std::getenv("BINANCE_ISA");
+    if (ev == nullptr)
+      return host;
+
+    for (int i = int(isa::scalar); i <= int(host); i++)
+    {
+      if (std::strcmp(ev, to_string(isa(i))) == 0)
+        return isa(i);
+    }
+    return host;
+  }();
+  return v;
+}
+}  // namespace cpu
+}  // namespace binance
+
+#endif
@@ -7,7 +7,9 @@
 
 #include <binance/conv.hpp>
 #include <boost/utility/string_view.hpp>
-#include <iostream>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <string>
 #include <string_view>
 
@@ -15,34 +17,149 @@ namespace binance
 {
 namespace crypto
 {
+// signer computes HMAC-SHA256 signatures with one key. The key schedule runs
+// once, in the constructor: the SHA-256 states after hashing the inner and
+// outer key pads are kept, and every signature starts from copies of them,
+// so a signature costs the hashing of the message and two blocks.
+//
+// A signer is meant to live as long as its key:
+//
+//   crypto::signer s(secret);
+//   char sig[crypto::signer::hex_size];
+//   s.sign(query, sig);
 class signer
 {
-  ::HMAC_CTX* hmac_;
-  binance::conv::hex hex_;
+public:
+  static constexpr size_t block_size  = SHA256_CBLOCK;
+  static constexpr size_t digest_size = SHA256_DIGEST_LENGTH;
+  static constexpr size_t hex_size    = 2 * digest_size;
+
+  // state is a SHA-256 state keyed by the signer. It can be copied to sign
+  // messages starting with the same bytes, see signer::begin. Copies made by
+  // assignment reuse the context of the target.
+  class state
+  {
+    friend class signer;
+
+    struct deleter
+    {
+      void operator()(::EVP_MD_CTX* ctx) const
+      {
+        ::EVP_MD_CTX_free(ctx);
+      }
+    };
+    std::unique_ptr<::EVP_MD_CTX, deleter> ctx_;
+
+  public:
+    state()
+        : ctx_(::EVP_MD_CTX_new())
+    {
+      if (!ctx_)
+        throw std::bad_alloc{};
+    }
+    state(const state& o)
+        : state()
+    {
+      *this = o;
+    }
+    state(state&&) = default;
+    state& operator=(const state& o)
+    {
+      if (!ctx_)
+        *this = state();
+      if (::EVP_MD_CTX_copy_ex(ctx_.get(), o.ctx_.get()) != 1)
+        throw std::bad_alloc{};
+      return *this;
+    }
+    state& operator=(state&&) = default;
+
+    state& update(std::string_view s)
+    {
+      ::EVP_DigestUpdate(ctx_.get(), s.data(), s.size());
+      return *this;
+    }
+  };
+
+private:
+  state inner_;
+  state outer_;
+  // used by sign.
+  state work_;
+  // used by update and final.
+  state pending_;
+  std::string hex_;
 
 public:
   signer() = delete;
-  signer(const std::string& key)
-      : hmac_(::HMAC_CTX_new())
+  signer(std::string_view key)
+  {
+    unsigned char k[block_size] = {};
+    if (key.size() > block_size)
+      ::EVP_Digest(key.data(), key.size(), k, nullptr, ::EVP_sha256(),
+                   nullptr);
+    else
+      std::memcpy(k, key.data(), key.size());
+
+    unsigned char pad[block_size];
+    for (size_t i = 0; i < block_size; i++)
+      pad[i] = k[i] ^ 0x36;
+    ::EVP_DigestInit_ex(inner_.ctx_.get(), ::EVP_sha256(), nullptr);
+    ::EVP_DigestUpdate(inner_.ctx_.get(), pad, block_size);
+
+    for (size_t i = 0; i < block_size; i++)
+      pad[i] = k[i] ^ 0x5c;
+    ::EVP_DigestInit_ex(outer_.ctx_.get(), ::EVP_sha256(), nullptr);
+    ::EVP_DigestUpdate(outer_.ctx_.get(), pad, block_size);
+
+    pending_ = inner_;
+  }
+
+  // begin returns the keyed state a message is hashed from.
+  state begin() const
   {
-    ::HMAC_Init_ex(hmac_, &key[0], key.size(), ::EVP_sha256(), nullptr);
+    return inner_;
   }
-  ~signer()
+
+  // finish ends the signature of the message hashed into s, writing
+  // hex_size characters at out. s is used for the outer hash, so it must be
+  // assigned a new state before being updated again.
+  void finish(state& s, char* out) const
   {
-    ::HMAC_CTX_free(hmac_);
+    unsigned char hash[digest_size];
+    ::EVP_DigestFinal_ex(s.ctx_.get(), hash, nullptr);
+
+    s = outer_;
+    ::EVP_DigestUpdate(s.ctx_.get(), hash, digest_size);
+    ::EVP_DigestFinal_ex(s.ctx_.get(), hash, nullptr);
+
+#ifndef BINANCE_DISABLE_SIMD_DISPATCH
+    conv::active_kernels().hex_encode(hash, digest_size, out);
+#else
+    conv::native::hex_encode(hash, digest_size, out);
+#endif
   }
+
+  // sign writes the signature of msg, hex_size characters, at out.
+  void sign(std::string_view msg, char* out)
+  {
+    work_ = inner_;
+    finish(work_.update(msg), out);
+  }
+
   void update(const boost::string_view& s)
   {
-    ::HMAC_Update(hmac_, (unsigned char*) &s[0], s.size());
+    pending_.update(std::string_view(s.data(), s.size()));
   }
+  // final returns the signature of what was passed to update since the last
+  // call, and starts over.
   const std::string& final()
   {
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int size;
-
-    ::HMAC_Final(hmac_, &hash[0], &size);
+    char out[hex_size];
+    finish(pending_, out);
+    pending_ = inner_;
 
-    return hex_.clear().encode(&hash[0], size).final();
+    hex_.assign(out, hex_size);
+    return hex_;
   }
 };
 }  // namespace crypto
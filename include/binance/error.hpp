@@ -2,61 +2,122 @@
 #define BINANCE_ERROR_HPP
 
 #include <boost/system/error_code.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
+#include <string_view>
 
 namespace binance
 {
+// error is the result of a failed request. It is one of:
+//
+//  - network: the request could not be sent or answered, see system_error.
+//  - http: the server answered with a status other than 200, see code.
+//  - api: the server answered with an error code (code < 0) and message.
+//  - decode: the response could not be read into its message.
+//
+// The message is kept inline, truncated to max_message characters, so
+// errors are built without allocations.
 class error
 {
+public:
+  enum class kind : uint8_t
+  {
+    none,
+    network,
+    http,
+    api,
+    decode,
+  };
+
+  static constexpr size_t max_message = 127;
+
+private:
+  kind kind_;
+  uint8_t size_;
   int ec_;
-  std::string ec_s_;
+  boost::system::error_code sys_;
+  char msg_[max_message];
 
 public:
   error()
-      : ec_(0)
+      : kind_(kind::none)
+      , size_(0)
+      , ec_(0)
   {
   }
   error(boost::system::error_code ec)
+      : kind_(ec ? kind::network : kind::none)
+      , size_(0)
+      , ec_(ec ? -1 : 0)
+      , sys_(ec)
+  {
+  }
+  error(unsigned int code, std::string_view body)
+      : kind_(kind::http)
+      , size_(0)
+      , ec_(int(code))
   {
-    ec_   = -1;
-    ec_s_ = ec.message();
+    *this = body;
   }
-  error(unsigned int code, const std::string& body)
+  error(kind k, int code, std::string_view message)
+      : kind_(k)
+      , size_(0)
+      , ec_(code)
   {
-    ec_ = int(code);
-    ec_s_ = body;
+    *this = message;
   }
   operator bool() const
   {
     return ec_ != 0;
   }
+  // an error code read from a response makes an api error.
   error& operator=(int code)
   {
-    ec_ = code;
+    ec_   = code;
+    kind_ = code != 0 ? kind::api : kind::none;
     return *this;
   }
-  error& operator=(const std::string& s)
+  error& operator=(std::string_view s)
   {
-    ec_s_ = s;
+    size_ = uint8_t(std::min(s.size(), max_message));
+    std::memcpy(msg_, s.data(), size_);
     return *this;
   }
-  const int code() const
+  kind category() const
+  {
+    return kind_;
+  }
+  int code() const
   {
     return ec_;
   }
-  const std::string& to_string() const
+  const boost::system::error_code& system_error() const
+  {
+    return sys_;
+  }
+  std::string_view message() const
+  {
+    return std::string_view(msg_, size_);
+  }
+  // to_string returns the message, or the description of a network error.
+  std::string to_string() const
   {
-    return ec_s_;
+    if (kind_ == kind::network && size_ == 0)
+      return sys_.message();
+    return std::string(message());
   }
   friend std::ostream& operator<<(std::ostream& os, const error& ec);
 };
 
-std::ostream& operator<<(std::ostream& os, const error& ec)
+inline std::ostream& operator<<(std::ostream& os, const error& ec)
 {
-  os << ec.ec_ << ": " << ec.ec_s_;
+  os << ec.ec_ << ": " << ec.to_string();
   return os;
 }
 }  // namespace binance
 
 
-#endif
\ No newline at end of file
+#endif
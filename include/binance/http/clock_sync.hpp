@@ -0,0 +1,183 @@
+#ifndef BINANCE_HTTP_CLOCK_SYNC_HPP
+#define BINANCE_HTTP_CLOCK_SYNC_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace binance
+{
+namespace http
+{
+// clock_sync estimates the offset of the exchange clock from the local one,
+// from samples of /fapi/v1/time.
+//
+// The server is assumed to read its clock halfway through the round trip, so
+// a sample is off by rtt/2 at most: only the samples with a round trip below
+// the median are kept. With enough of them over a minute or more, a line
+// fitted through their offsets follows the drift of the local clock.
+class clock_sync
+{
+public:
+  using clock      = std::chrono::system_clock;
+  using time_point = clock::time_point;
+  using duration   = clock::duration;
+
+private:
+  struct sample
+  {
+    time_point local;  // when the server read its clock, in local time
+    duration offset;
+    duration rtt;
+  };
+
+  static constexpr size_t capacity = 32;
+  // drifts above 500ppm are a bad fit, not a clock.
+  static constexpr double max_drift = 500e-6;
+
+  std::array<sample, capacity> samples_;
+  size_t size_;
+  size_t next_;
+
+  // offset_ at base_, plus drift_ per tick since.
+  time_point base_;
+  duration offset_;
+  double drift_;
+  duration rtt_;  // the lowest of the samples kept
+
+public:
+  clock_sync()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    size_   = 0;
+    next_   = 0;
+    base_   = time_point();
+    offset_ = duration::zero();
+    drift_  = 0;
+    rtt_    = duration::zero();
+  }
+
+  // add takes the time of the server, read by a request sent at `sent` and
+  // answered at `received`.
+  void add(time_point sent, time_point received, time_point server)
+  {
+    if (received < sent)
+      return;
+    duration rtt    = received - sent;
+    time_point mid  = sent + rtt / 2;
+    samples_[next_] = {mid, server - mid, rtt};
+    next_           = (next_ + 1) % capacity;
+    size_           = std::min(size_ + 1, capacity);
+    estimate();
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  // offset returns how far the exchange clock is ahead of the local one.
+  duration offset(time_point now = clock::now()) const
+  {
+    auto ticks = double((now - base_).count()) * drift_;
+    return offset_ + duration(duration::rep(ticks));
+  }
+
+  // drift returns how fast the offset changes, in seconds per second.
+  double drift() const
+  {
+    return drift_;
+  }
+
+  // uncertainty returns the largest error of the offset, rtt/2 of the best
+  // sample.
+  duration uncertainty() const
+  {
+    return rtt_ / 2;
+  }
+
+  // server_now returns the time on the exchange clock.
+  time_point server_now() const
+  {
+    auto now = clock::now();
+    return now + offset(now);
+  }
+
+  // to_local returns the local time of an exchange time, as the event time
+  // of a message.
+  time_point to_local(time_point server) const
+  {
+    return server - offset(server);
+  }
+
+  // timestamp returns the exchange time in milliseconds, for the timestamp
+  // of signed requests.
+  int64_t timestamp() const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               server_now().time_since_epoch())
+        .count();
+  }
+
+private:
+  void estimate()
+  {
+    std::array<sample, capacity> s;
+    std::copy(samples_.begin(), samples_.begin() + size_, s.begin());
+
+    // the samples with a round trip not above the median.
+    size_t mid = size_ / 2;
+    std::nth_element(
+        s.begin(), s.begin() + mid, s.begin() + size_,
+        [](const sample& a, const sample& b) { return a.rtt < b.rtt; });
+    size_t n = mid + 1;
+
+    rtt_          = s[0].rtt;
+    time_point t0 = s[0].local;
+    time_point t1 = s[0].local;
+    for (size_t i = 0; i < n; i++)
+    {
+      rtt_ = std::min(rtt_, s[i].rtt);
+      t0   = std::min(t0, s[i].local);
+      t1   = std::max(t1, s[i].local);
+    }
+
+    // least squares of offset over local time, relative to t0.
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      mx += double((s[i].local - t0).count());
+      my += double(s[i].offset.count());
+    }
+    mx /= double(n);
+    my /= double(n);
+
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      double dx = double((s[i].local - t0).count()) - mx;
+      sxx += dx * dx;
+      sxy += dx * (double(s[i].offset.count()) - my);
+    }
+
+    double slope = 0;
+    if (n >= 3 && t1 - t0 >= std::chrono::seconds(60) && sxx > 0)
+      slope = sxy / sxx;
+    if (std::abs(slope) > max_drift)
+      slope = 0;
+
+    base_   = t0 + duration(duration::rep(mx));
+    offset_ = duration(duration::rep(my));
+    drift_  = slope;
+  }
+};
+}  // namespace http
+}  // namespace binance
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef BINANCE_HTTP_HEDGING_HPP
+#define BINANCE_HTTP_HEDGING_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace binance
+{
+namespace http
+{
+// hedge_policy enables hedged reads of market data: a GET not answered after
+// the given quantile of the recent response times, clamped to
+// [min_delay, max_delay], is sent again on another idle connection and the
+// first answer is taken. Until min_samples responses were timed, max_delay is
+// used.
+struct hedge_policy
+{
+  bool enabled    = false;
+  double quantile = 0.95;
+  std::chrono::milliseconds min_delay{5};
+  std::chrono::milliseconds max_delay{1000};
+  size_t min_samples = 20;
+};
+
+// latency_window keeps the last response times, in microseconds.
+class latency_window
+{
+  static constexpr size_t capacity = 256;
+
+  std::array<uint32_t, capacity> samples_;
+  size_t size_;
+  size_t next_;
+
+public:
+  latency_window()
+      : size_(0)
+      , next_(0)
+  {
+  }
+
+  void add(std::chrono::microseconds d)
+  {
+    auto us         = std::clamp<int64_t>(d.count(), 0, UINT32_MAX);
+    samples_[next_] = uint32_t(us);
+    next_           = (next_ + 1) % capacity;
+    size_           = std::min(size_ + 1, capacity);
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  // quantile returns the time q of the samples are below, zero if empty.
+  std::chrono::microseconds quantile(double q) const
+  {
+    if (size_ == 0)
+      return std::chrono::microseconds::zero();
+    std::array<uint32_t, capacity> s = samples_;
+    size_t k = std::min(size_t(q * double(size_)), size_ - 1);
+    std::nth_element(s.begin(), s.begin() + k, s.begin() + size_);
+    return std::chrono::microseconds(s[k]);
+  }
+
+  // hedge_delay returns how long a request waits before it is hedged.
+  std::chrono::microseconds hedge_delay(const hedge_policy& p) const
+  {
+    if (size_ < p.min_samples)
+      return p.max_delay;
+    return std::clamp<std::chrono::microseconds>(quantile(p.quantile),
+                                                 p.min_delay, p.max_delay);
+  }
+};
+}  // namespace http
+}  // namespace binance
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef BINANCE_HTTP_MESSAGES_HPP
 #define BINANCE_HTTP_MESSAGES_HPP
 
+#include <binance/http/order_template.hpp>
 #include <binance/http/query_args.hpp>
 #include <binance/json.hpp>
+#include <binance/kline_series.hpp>
+#include <binance/schema.hpp>
+#include <binance/symbols.hpp>
 #include <boost/beast/http/empty_body.hpp>
 #include <boost/beast/http/message.hpp>
 #include <boost/url.hpp>
@@ -13,24 +17,6 @@ namespace binance
 {
 namespace http
 {
-void parse_args(std::string& target, std::string& query,
-                const std::vector<query_args::key_value>& args)
-{
-  namespace http = boost::beast::http;
-  for (auto& kv : args)
-  {
-    const auto& v = boost::variant2::visit(args_visitor_to_string(), kv.second);
-    if (kv.first.empty())
-      target += "/" + v;
-    else
-    {
-      if (query.size() > 0)
-        query += "&";
-      query += kv.first + "=" + v;
-    }
-  }
-}
-
 template<class T>
 struct paginator
 {
@@ -42,21 +28,18 @@ struct paginator
   really_inline void set_current_page(size_t n)
   {
     T& v = static_cast<T&>(*this);
-    v.insert_kv({"currentPage", std::to_string(n)});
+    v.insert_kv({"currentPage", n});
   }
   really_inline void set_page_size(size_t n)
   {
     T& v = static_cast<T&>(*this);
-    v.insert_kv({"pageSize", std::to_string(n)});
-  }
-  paginator& operator=(const json::object& jb)
-  {
-    json::value_to(jb, "totalNum", total_num);
-    json::value_to(jb, "totalPage", total_page);
-    json::value_to(jb, "currentPage", current_page);
-    json::value_to(jb, "pageSize", page_size);
-    return *this;
+    v.insert_kv({"pageSize", n});
   }
+  BINANCE_SCHEMA(paginator,
+                 schema::make("totalNum", &self::total_num),
+                 schema::make("totalPage", &self::total_page),
+                 schema::make("currentPage", &self::current_page),
+                 schema::make("pageSize", &self::page_size))
 };
 
 namespace messages
@@ -67,7 +50,14 @@ namespace messages
     insert_kv({K, V});              \
     return *this;                   \
   }
-#define _value_to(x, e) json::value_to(jb, x, e)
+// https://binance-docs.github.io/apidocs/futures/en/#check-server-time
+struct server_time : public query_args
+{
+  time_point_t time;  // serverTime
+
+  server_time()        = default;
+  BINANCE_SCHEMA(server_time, schema::make("serverTime", &self::time))
+};
 // https://binance-docs.github.io/apidocs/futures/en/#exchange-information
 struct exchange_info : public query_args
 {
@@ -77,14 +67,11 @@ struct exchange_info : public query_args
     int limit;               // limit
     string_type interval;    // interval
     string_type limit_type;  // rateLimitType
-    rate_limit& operator=(const json::object& jb)
-    {
-      _value_to("intervalNum", interval_num);
-      _value_to("limit", limit);
-      _value_to("interval", interval);
-      _value_to("rateLimitType", limit_type);
-      return *this;
-    }
+    BINANCE_SCHEMA(rate_limit,
+                   schema::make("intervalNum", &self::interval_num),
+                   schema::make("limit", &self::limit),
+                   schema::make("interval", &self::interval),
+                   schema::make("rateLimitType", &self::limit_type))
   };
 
   struct symbol_data
@@ -94,6 +81,7 @@ struct exchange_info : public query_args
     int base_precision;       // baseAssetPrecision
     int quote_precision;      // quotePrecision
     string_type symbol;       // symbol
+    symbol_id sym_id;         // symbol (interned)
     string_type status;       // status
     string_type base_asset;   // baseAsset
     string_type quote_asset;  // quoteAsset
@@ -106,46 +94,39 @@ struct exchange_info : public query_args
     // TODO: filters
     // TODO: OrderType
     // TODO: timeInForce
-    symbol_data& operator=(const json::object& jb)
-    {
-      _value_to("pricePrecision", price_precision);
-      _value_to("quantityPrecision", qty_precision);
-      _value_to("baseAssetPrecision", base_precision);
-      _value_to("quotePrecision", quote_precision);
-      _value_to("symbol", symbol);
-      _value_to("status", status);
-      _value_to("baseAsset", base_asset);
-      _value_to("quoteAsset", quote_asset);
-      _value_to("mainMarginPercent", m_margin_pct);
-      _value_to("requiredMarginPercent", r_margin_pct);
-      _value_to("settlePlan", settle_plan);
-      _value_to("triggerProtect", trigger_protect);
-      return *this;
-    }
+    BINANCE_SCHEMA(symbol_data,
+                   schema::make("pricePrecision", &self::price_precision),
+                   schema::make("quantityPrecision", &self::qty_precision),
+                   schema::make("baseAssetPrecision", &self::base_precision),
+                   schema::make("quotePrecision", &self::quote_precision),
+                   schema::make("symbol", &self::symbol, &self::sym_id),
+                   schema::make("status", &self::status),
+                   schema::make("baseAsset", &self::base_asset),
+                   schema::make("quoteAsset", &self::quote_asset),
+                   schema::make("maintMarginPercent", &self::m_margin_pct),
+                   schema::make("requiredMarginPercent", &self::r_margin_pct),
+                   schema::make("settlePlan", &self::settle_plan),
+                   schema::make("triggerProtect", &self::trigger_protect))
   };
 
   time_point_t server_time;             // serverTime
   std::vector<rate_limit> rate_limits;  // rateLimits
   std::vector<symbol_data> symbols;     // symbols
 
-  exchange_info& operator=(const json::object& jb)
-  {
-    _value_to("serverTime", server_time);
-    _value_to("rateLimits", rate_limits);
-    _value_to("symbols", symbols);
-    return *this;
-  }
+  BINANCE_SCHEMA(exchange_info,
+                 schema::make("serverTime", &self::server_time),
+                 schema::make("rateLimits", &self::rate_limits),
+                 schema::make("symbols", &self::symbols))
 };
 // TODO: Get it from websocket?? Or commonly declare?
 struct price_point
 {
-  double price;
-  double qty;
-  price_point& operator=(const json::array& jr)
-  {
-    json::value_to(jr.begin(), jr.end(), price, qty);
-    return *this;
-  }
+  double price;  // 0
+  double qty;    // 1
+
+  BINANCE_SCHEMA_ARRAY(price_point,
+                       schema::make("price", &self::price),
+                       schema::make("qty", &self::qty))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#order-book
 struct orderbook : public query_args
@@ -168,14 +149,24 @@ struct orderbook : public query_args
     return *this;
   }
 
-  orderbook& operator=(const json::object& jb)
+  BINANCE_SCHEMA(orderbook,
+                 schema::make("lastUpdateId", &self::last_update_id),
+                 schema::make("E", &self::output_time),
+                 schema::make("T", &self::x_time),
+                 schema::make("bids", &self::bids),
+                 schema::make("asks", &self::asks))
+
+  // for_each_bid and for_each_ask decode the levels one by one, straight
+  // from the response, see json::for_each.
+  template<class F>
+  static size_t for_each_bid(const json::object& jb, F&& f)
   {
-    _value_to("lastUpdateId", last_update_id);
-    _value_to("E", output_time);
-    _value_to("T", x_time);
-    _value_to("bids", bids);
-    _value_to("asks", asks);
-    return *this;
+    return json::for_each<price_point>(jb, "bids", std::forward<F>(f));
+  }
+  template<class F>
+  static size_t for_each_ask(const json::object& jb, F&& f)
+  {
+    return json::for_each<price_point>(jb, "asks", std::forward<F>(f));
   }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#recent-trades-list
@@ -189,16 +180,13 @@ struct recent_trades : public query_args
     double price;         // price
     double qty;           // qty
     double quote_qty;     // quoteQty
-    trade& operator=(const json::object& jb)
-    {
-      _value_to("id", id);
-      _value_to("time", time);
-      _value_to("isBuyerMaker", is_buyer_maker);
-      _value_to("price", price);
-      _value_to("qty", qty);
-      _value_to("quoteQty", quote_qty);
-      return *this;
-    }
+    BINANCE_SCHEMA(trade,
+                   schema::make("id", &self::id),
+                   schema::make("time", &self::time),
+                   schema::make("isBuyerMaker", &self::is_buyer_maker),
+                   schema::make("price", &self::price),
+                   schema::make("qty", &self::qty),
+                   schema::make("quoteQty", &self::quote_qty))
   };
 
   std::vector<trade> trades;
@@ -227,6 +215,7 @@ struct recent_trades : public query_args
 struct mark_price : public query_args
 {
   string_type symbol;              // symbol
+  symbol_id sym_id;                // symbol (interned)
   double price;                    // markPrice
   double index_price;              // indexPrice
   double last_funding_rate;        // lastFundingRate
@@ -240,22 +229,20 @@ struct mark_price : public query_args
   {
   }
 
-  mark_price& operator=(const json::object& jb)
-  {
-    _value_to("symbol", symbol);
-    _value_to("markPrice", price);
-    _value_to("indexPrice", index_price);
-    _value_to("lastFundingRate", last_funding_rate);
-    _value_to("nextFundingTime", next_funding_time);
-    _value_to("time", time);
-    return *this;
-  }
+  BINANCE_SCHEMA(mark_price,
+                 schema::make("symbol", &self::symbol, &self::sym_id),
+                 schema::make("markPrice", &self::price),
+                 schema::make("indexPrice", &self::index_price),
+                 schema::make("lastFundingRate", &self::last_funding_rate),
+                 schema::make("nextFundingTime", &self::next_funding_time),
+                 schema::make("time", &self::time))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#get-funding-rate-history
 // https://binance-docs.github.io/apidocs/futures/en/#24hr-ticker-price-change-statistics
 struct price_ticker : public query_args
 {
   string_type symbol;  // symbol
+  symbol_id sym_id;    // symbol (interned)
   double price;        // price
   time_point_t time;   // time
 
@@ -266,13 +253,10 @@ struct price_ticker : public query_args
   {
   }
 
-  price_ticker& operator=(const json::object& jb)
-  {
-    _value_to("symbol", symbol);
-    _value_to("price", price);
-    _value_to("time", time);
-    return *this;
-  }
+  BINANCE_SCHEMA(price_ticker,
+                 schema::make("symbol", &self::symbol, &self::sym_id),
+                 schema::make("price", &self::price),
+                 schema::make("time", &self::time))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#symbol-order-book-ticker
 // https://binance-docs.github.io/apidocs/futures/en/#get-all-liquidation-orders
@@ -289,35 +273,39 @@ struct get_position_mode : public query_args
   bool dual_position;
 
   get_position_mode()        = default;
-  get_position_mode& operator=(const json::object& jb)
-  {
-    json::value_to(jb, "dualSidePosition", dual_position);
-    return *this;
-  }
+  BINANCE_SCHEMA(get_position_mode,
+                 schema::make("dualSidePosition", &self::dual_position))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#kline-candlestick-data
 struct kline_data : public query_args
 {
   struct kline
   {
-    time_point_t open_time;
-    double open;
-    double high;
-    double low;
-    double close;
-    double volume;
-    time_point_t close_time;
-    double quote_volume;
-    int64_t trades;
-    double taker_base_vol;
-    double taker_quote_vol;
-    kline& operator=(const json::array& jr)
-    {
-      json::value_to(jr.begin(), jr.end(), open_time, open, high, low, close,
-                     volume, close_time, quote_volume, trades, taker_base_vol,
-                     taker_quote_vol);
-      return *this;
-    }
+    time_point_t open_time;   // 0
+    double open;              // 1
+    double high;              // 2
+    double low;               // 3
+    double close;             // 4
+    double volume;            // 5
+    time_point_t close_time;  // 6
+    double quote_volume;      // 7
+    int64_t trades;           // 8
+    double taker_base_vol;    // 9
+    double taker_quote_vol;   // 10
+
+    BINANCE_SCHEMA_ARRAY(kline,
+                         schema::make("openTime", &self::open_time),
+                         schema::make("open", &self::open),
+                         schema::make("high", &self::high),
+                         schema::make("low", &self::low),
+                         schema::make("close", &self::close),
+                         schema::make("volume", &self::volume),
+                         schema::make("closeTime", &self::close_time),
+                         schema::make("quoteVolume", &self::quote_volume),
+                         schema::make("trades", &self::trades),
+                         schema::make("takerBaseVolume", &self::taker_base_vol),
+                         schema::make("takerQuoteVolume",
+                                      &self::taker_quote_vol))
   };
 
   std::vector<kline> klines;
@@ -339,6 +327,28 @@ struct kline_data : public query_args
     return *this;
   }
 };
+// kline_series_data is kline_data decoded by columns, see kline_series.
+struct kline_series_data : public query_args
+{
+  kline_series series;
+
+  kline_series_data() = delete;
+  kline_series_data(const std::string& symbol, const std::string& interval)
+      : query_args{{"symbol", symbol}, {"interval", interval}}
+  {
+  }
+  setter(kline_series_data&, set_start_time, int64_t, "startTime", start);
+  setter(kline_series_data&, set_end_time, int64_t, "endTime", end);
+  setter(kline_series_data&, set_interval, const std::string&, "interval",
+         interval);
+  setter(kline_series_data&, set_limit, size_t, "limit", limit);
+
+  kline_series_data& operator=(const json::array& jb)
+  {
+    series = jb;
+    return *this;
+  }
+};
 struct order_base
 {
   // TODO: cumQty, cumQuote, origQty, reduceOnly, closePosition, origType
@@ -356,28 +366,26 @@ struct order_base
   string_type pos_side;       // positionSide
   string_type status;         // status
   string_type symbol;         // symbol
+  symbol_id sym_id;           // symbol (interned)
   string_type time_in_force;  // timeInForce
   string_type working_type;   // workingType
-  order_base& operator=(const json::object& jb)
-  {
-    _value_to("updateTime", update_time);
-    _value_to("orderId", order_id);
-    _value_to("executedQty", executed_qty);
-    _value_to("avgPrice", avg_price);
-    _value_to("price", price);
-    _value_to("priceRate", price_rate);
-    _value_to("stopPrice", stop_price);
-    _value_to("activatePrice", activate_price);
-    _value_to("clientOrderId", client_oid);
-    _value_to("type", type);
-    _value_to("side", side);
-    _value_to("positionSide", pos_side);
-    _value_to("status", status);
-    _value_to("symbol", symbol);
-    _value_to("timeInForce", time_in_force);
-    _value_to("workingType", working_type);
-    return *this;
-  }
+  BINANCE_SCHEMA(order_base,
+                 schema::make("updateTime", &self::update_time),
+                 schema::make("orderId", &self::order_id),
+                 schema::make("executedQty", &self::executed_qty),
+                 schema::make("avgPrice", &self::avg_price),
+                 schema::make("price", &self::price),
+                 schema::make("priceRate", &self::price_rate),
+                 schema::make("stopPrice", &self::stop_price),
+                 schema::make("activatePrice", &self::activate_price),
+                 schema::make("clientOrderId", &self::client_oid),
+                 schema::make("type", &self::type),
+                 schema::make("side", &self::side),
+                 schema::make("positionSide", &self::pos_side),
+                 schema::make("status", &self::status),
+                 schema::make("symbol", &self::symbol, &self::sym_id),
+                 schema::make("timeInForce", &self::time_in_force),
+                 schema::make("workingType", &self::working_type))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#new-order-trade
 struct place_order : public query_args
@@ -385,25 +393,85 @@ struct place_order : public query_args
   order_base result;
 
   place_order() = delete;
-  place_order(const std::string& symbol, order_side side, order_type type)
+  place_order(std::string_view symbol, order_side side, order_type type)
       : query_args{{"symbol", symbol},
                    {"side", order_side_string[side]},
                    {"type", order_type_string[type]}}
+      , price_precision_(-1)
+      , qty_precision_(-1)
+      , template_(nullptr)
+  {
+  }
+  // an order made from t only carries the arguments t doesn't have, and is
+  // signed from its state. t must outlive the order.
+  explicit place_order(const order_template& t)
+      : price_precision_(t.price_precision())
+      , qty_precision_(t.qty_precision())
+      , template_(&t)
+  {
+  }
+  // prices and quantities are written with the precision of the symbol.
+  place_order(const exchange_info::symbol_data& s, order_side side,
+              order_type type)
+      : place_order(s.symbol, side, type)
   {
+    set_precision(s.price_precision, s.qty_precision);
   }
 
-  setter(place_order&, set_qty, double, "quantity", qty);
-  setter(place_order&, set_price, double, "price", price);
+  // set_precision sets the digits after the point of prices and quantities,
+  // as in exchange_info::symbol_data. By default they are written with the
+  // shortest digits that read back the same value.
+  place_order& set_precision(int price, int qty)
+  {
+    price_precision_ = price;
+    qty_precision_   = qty;
+    query_args::set_precision("quantity", qty);
+    query_args::set_precision("price", price);
+    query_args::set_precision("stopPrice", price);
+    query_args::set_precision("activationPrice", price);
+    return *this;
+  }
+  int price_precision() const
+  {
+    return price_precision_;
+  }
+  int qty_precision() const
+  {
+    return qty_precision_;
+  }
+  const order_template* from() const
+  {
+    return template_;
+  }
+
+  place_order& set_qty(double qty)
+  {
+    insert_kv({"quantity", qty, qty_precision_});
+    return *this;
+  }
+  place_order& set_price(double price)
+  {
+    insert_kv({"price", price, price_precision_});
+    return *this;
+  }
+  place_order& set_stop_price(double price)
+  {
+    insert_kv({"stopPrice", price, price_precision_});
+    return *this;
+  }
+  place_order& set_activation_price(double price)
+  {
+    insert_kv({"activationPrice", price, price_precision_});
+    return *this;
+  }
   setter(place_order&, set_reduce_only, const std::string&, "reduceOnly",
          reduce_only);
   setter(place_order&, set_client_order_id, const std::string&,
          "newClientOrderId", order_id);
-  setter(place_order&, set_stop_price, double, "stopPrice", price);
   setter(place_order&, set_close_position, const std::string&, "closePosition",
          close_p);
-  setter(place_order&, set_activation_price, double, "activationPrice", price);
   setter(place_order&, set_callback_rate, double, "callbackRate", rate);
-  setter(place_order&, set_recv_window, double, "recvWindow", recv_w);
+  setter(place_order&, set_recv_window, int64_t, "recvWindow", recv_w);
 
   // setter(place_order&, set_symbol, const std::string&, "symbol", symbol)
   // setter(place_order&, set_side, const std::string&, "side", side)
@@ -434,6 +502,11 @@ struct place_order : public query_args
     result = jb;
     return *this;
   }
+
+private:
+  int price_precision_;
+  int qty_precision_;
+  const order_template* template_;
 };
 
 // https://binance-docs.github.io/apidocs/futures/en/#cancel-order-trade
@@ -476,12 +549,9 @@ struct cancel_order_all : public query_args
 
   setter(cancel_order_all&, set_recv_window, int64_t, "recvWindow", win);
 
-  cancel_order_all& operator=(const json::object& jb)
-  {
-    _value_to("code", code);
-    _value_to("msg", msg);
-    return *this;
-  }
+  BINANCE_SCHEMA(cancel_order_all,
+                 schema::make("code", &self::code),
+                 schema::make("msg", &self::msg))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#query-current-open-order-user_data
 struct current_open_order : public query_args
@@ -526,11 +596,8 @@ struct listen_key : public query_args
   string_type key;
 
   listen_key()        = default;
-  listen_key& operator=(const json::object& jb)
-  {
-    json::value_to(jb, "listenKey", key);
-    return *this;
-  }
+  BINANCE_SCHEMA(listen_key,
+                 schema::make("listenKey", &self::key))
 };
 struct empty_args : public query_args
 {
@@ -541,7 +608,6 @@ struct empty_args : public query_args
     return *this;
   }
 };
-#undef _value_to
 #undef setter
 }  // namespace messages
 }  // namespace http
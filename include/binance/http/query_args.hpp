@@ -2,152 +2,318 @@
 #define BINANCE_QUERY_ARGS_HPP
 
 #include <binance/common.hpp>
-#include <boost/json.hpp>
-#include <boost/variant2/variant.hpp>
+#include <boost/container/small_vector.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
-#include <vector>
 
 namespace binance
 {
 namespace http
 {
-struct args_visitor_to_string
+// query_key is a key known at compile time: only string literals convert to
+// it, and comparing two keys from the same literal is a pointer compare.
+class query_key
 {
-  // TODO: Avoid the copy constructor here
-  std::string operator()(const std::string& s) const
-  {
-    return s;
-  }
-  std::string operator()(size_t n) const
-  {
-    return std::to_string(n);
-  }
-  std::string operator()(bool b) const
+  std::string_view s_;
+
+public:
+  constexpr query_key() = default;
+  template<size_t N>
+  constexpr query_key(const char (&s)[N])
+      : s_(s, N - 1)
   {
-    return b ? "true" : "false";
   }
-  std::string operator()(int64_t n) const
+  constexpr std::string_view view() const
   {
-    return std::to_string(n);
+    return s_;
   }
-  std::string operator()(double d) const
+  bool operator==(query_key o) const
   {
-    return std::to_string(d);
+    return s_.data() == o.s_.data() || s_ == o.s_;
   }
 };
 
+// query_args stores the arguments of a request by value in small inline
+// buffers, and formats them straight into the query with std::to_chars.
+// Numbers are kept as numbers until then; doubles are written with their
+// precision, or else the shortest digits that read back the same value.
 class query_args
 {
 public:
-  using key_value =
-      std::pair<std::string, boost::variant2::variant<std::string, size_t,
-                                                      int64_t, bool, double>>;
+  enum class kind : uint8_t
+  {
+    text,
+    unsigned_number,
+    signed_number,
+    boolean,
+    real,
+  };
 
-  explicit query_args() = default;
-  explicit query_args(std::initializer_list<key_value> args)
+  // key_value is an argument on its way in: text points to the caller's
+  // string and is copied by insert_kv.
+  struct key_value
   {
-    for (const key_value& kv : args)
+    query_key key;
+    kind type;
+    int8_t precision = -1;
+    std::string_view text;
+    union
     {
-      if (is_second_empty(kv))
-        continue;
-      args_.push_back(kv);
+      uint64_t u;
+      int64_t i;
+      bool b;
+      double d;
+    };
+
+    template<class T>
+    key_value(query_key k, const T& v, int precision = -1)
+        : key(k)
+        , precision(int8_t(precision))
+        , u(0)
+    {
+      if constexpr (std::is_same_v<T, bool>)
+      {
+        type = kind::boolean;
+        b    = v;
+      }
+      else if constexpr (std::is_floating_point_v<T>)
+      {
+        type = kind::real;
+        d    = double(v);
+      }
+      else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+      {
+        type = kind::unsigned_number;
+        u    = uint64_t(v);
+      }
+      else if constexpr (std::is_integral_v<T>)
+      {
+        type = kind::signed_number;
+        i    = int64_t(v);
+      }
+      else
+      {
+        type = kind::text;
+        text = std::string_view(v);
+      }
     }
-  }
-  explicit query_args(const query_args& args)
+  };
+
+private:
+  struct entry
+  {
+    query_key key;
+    kind type;
+    int8_t precision;
+    uint16_t size;    // text
+    uint32_t offset;  // text, in text_
+    union
+    {
+      uint64_t u;
+      int64_t i;
+      bool b;
+      double d;
+    };
+  };
+
+  boost::container::small_vector<entry, 20> args_;
+  boost::container::small_vector<char, 256> text_;
+
+public:
+  explicit query_args() = default;
+  explicit query_args(std::initializer_list<key_value> args)
   {
-    args_ = args.args_;
+    for (const key_value& kv : args)
+      insert_kv(kv);
   }
+  query_args(const query_args&) = default;
+  query_args& operator=(const query_args&) = default;
+
   operator bool() const
   {
     return !args_.empty();
   }
-  really_inline const std::vector<key_value> args() const
+  bool empty() const
   {
-    return args_;
+    return args_.empty();
   }
-  really_inline bool get(const std::string& key, std::string& value) const
+  bool contains(query_key key) const
   {
-    for (auto& kv : args_)
-    {
-      if (kv.first == key)
-      {
-        value = boost::variant2::get<0>(kv.second);
-        return true;
-      }
-    }
-    return false;
+    return find(key) != nullptr;
   }
-  really_inline bool get(const std::string& key, size_t& value) const
+
+  really_inline bool get(query_key key, std::string_view& value) const
   {
-    for (auto& kv : args_)
-    {
-      if (kv.first == key)
-      {
-        value = boost::variant2::get<1>(kv.second);
-        return true;
-      }
-    }
-    return false;
+    const entry* e = find(key);
+    if (e == nullptr || e->type != kind::text)
+      return false;
+    value = text(*e);
+    return true;
   }
-  really_inline bool get(const std::string& key, int64_t& value) const
+  really_inline bool get(query_key key, std::string& value) const
   {
-    for (auto& kv : args_)
-    {
-      if (kv.first == key)
-      {
-        value = boost::variant2::get<2>(kv.second);
-        return true;
-      }
-    }
-    return false;
+    std::string_view v;
+    if (!get(key, v))
+      return false;
+    value.assign(v.data(), v.size());
+    return true;
+  }
+  really_inline bool get(query_key key, size_t& value) const
+  {
+    const entry* e = find(key);
+    if (e == nullptr || e->type != kind::unsigned_number)
+      return false;
+    value = size_t(e->u);
+    return true;
+  }
+  really_inline bool get(query_key key, int64_t& value) const
+  {
+    const entry* e = find(key);
+    if (e == nullptr || e->type != kind::signed_number)
+      return false;
+    value = e->i;
+    return true;
+  }
+  really_inline bool get(query_key key, bool& value) const
+  {
+    const entry* e = find(key);
+    if (e == nullptr || e->type != kind::boolean)
+      return false;
+    value = e->b;
+    return true;
+  }
+  really_inline bool get(query_key key, double& value) const
+  {
+    const entry* e = find(key);
+    if (e == nullptr || e->type != kind::real)
+      return false;
+    value = e->d;
+    return true;
   }
-  really_inline bool get(const std::string& key, bool& value) const
+
+  // insert_kv sets an argument, replacing the previous value of its key.
+  // Empty strings are not inserted.
+  really_inline void insert_kv(const key_value& kv)
   {
-    for (auto& kv : args_)
+    if (kv.type == kind::text && kv.text.empty())
+      return;
+
+    entry* e = find(kv.key);
+    if (e == nullptr)
+    {
+      e         = &args_.emplace_back();
+      e->key    = kv.key;
+      e->size   = 0;
+      e->offset = uint32_t(text_.size());
+    }
+    e->type      = kv.type;
+    e->precision = kv.precision;
+    e->u         = kv.u;
+    if (kv.type == kind::text)
     {
-      if (kv.first == key)
+      // in place if it fits, at the end otherwise.
+      if (kv.text.size() > e->size)
       {
-        value = boost::variant2::get<3>(kv.second);
-        return true;
+        e->offset = uint32_t(text_.size());
+        text_.resize(text_.size() + kv.text.size());
       }
+      std::copy(kv.text.begin(), kv.text.end(), text_.begin() + e->offset);
+      e->size = uint16_t(kv.text.size());
     }
-    return false;
   }
-  really_inline bool get(const std::string& key, double& value) const
+
+  // set_precision sets the digits after the point a real is written with.
+  void set_precision(query_key key, int digits)
   {
-    for (auto& kv : args_)
+    entry* e = find(key);
+    if (e != nullptr)
+      e->precision = int8_t(digits);
+  }
+
+  // append_to writes the arguments as `k=v&k=v` at the end of query. The
+  // ones without a key are path segments, written as `/v` at the end of
+  // path.
+  void append_to(std::string& path, std::string& query) const
+  {
+    for (auto& e : args_)
     {
-      if (kv.first == key)
+      std::string* out = &path;
+      if (e.key.view().empty())
+        path += '/';
+      else
       {
-        value = boost::variant2::get<4>(kv.second);
-        return true;
+        if (!query.empty())
+          query += '&';
+        query += e.key.view();
+        query += '=';
+        out = &query;
       }
+      append_value(*out, e);
     }
-    return false;
   }
-  really_inline void insert_kv(key_value&& kv)
+
+private:
+  std::string_view text(const entry& e) const
+  {
+    return std::string_view(text_.data() + e.offset, e.size);
+  }
+
+  const entry* find(query_key key) const
   {
-    if (is_second_empty(kv))
-      return;
-    for (auto& v : args_)
+    for (auto& e : args_)
     {
-      if (v.first == kv.first)
-      {
-        v.second = kv.second;
-        return;
-      }
+      if (e.key == key)
+        return &e;
     }
-    args_.push_back(kv);
+    return nullptr;
+  }
+  entry* find(query_key key)
+  {
+    return const_cast<entry*>(std::as_const(*this).find(key));
   }
 
-protected:
-  std::vector<key_value> args_;
+  // to_chars formats a number at the end of out, in place.
+  template<class... Args>
+  static void to_chars(std::string& out, size_t max, Args... args)
+  {
+    size_t n = out.size();
+    out.resize(n + max);
+    auto res = std::to_chars(out.data() + n, out.data() + out.size(), args...);
+    out.resize(size_t(res.ptr - out.data()));
+  }
 
-private:
-  inline bool is_second_empty(const key_value& kv)
+  void append_value(std::string& out, const entry& e) const
   {
-    return kv.second.index() == 0 && boost::variant2::get<0>(kv.second).empty();
+    // digits of the largest double written in fixed notation.
+    constexpr size_t max_real = 330;
+
+    switch (e.type)
+    {
+      case kind::text:
+        out += text(e);
+        break;
+      case kind::unsigned_number:
+        to_chars(out, 20, e.u);
+        break;
+      case kind::signed_number:
+        to_chars(out, 20, e.i);
+        break;
+      case kind::boolean:
+        out += e.b ? "true" : "false";
+        break;
+      case kind::real:
+        if (e.precision < 0)
+          to_chars(out, max_real, e.d, std::chars_format::fixed);
+        else
+          to_chars(out, max_real + e.precision, e.d, std::chars_format::fixed,
+                   int(e.precision));
+        break;
+    }
   }
 };
 }  // namespace http
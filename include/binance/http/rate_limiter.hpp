@@ -0,0 +1,327 @@
+#ifndef BINANCE_HTTP_RATE_LIMITER_HPP
+#define BINANCE_HTTP_RATE_LIMITER_HPP
+
+#include <binance/common.hpp>
+#include <binance/http/messages.hpp>
+#include <binance/http/query_args.hpp>
+#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+namespace binance
+{
+namespace http
+{
+// request_cost is what a request takes from each kind of limit.
+struct request_cost
+{
+  size_t weight = 1;  // REQUEST_WEIGHT
+  size_t orders = 0;  // ORDERS
+};
+
+// __depth_weight and __klines_weight grow with the `limit` of the request.
+inline size_t __depth_weight(size_t limit)
+{
+  if (limit <= 50)
+    return 2;
+  if (limit <= 100)
+    return 5;
+  if (limit <= 500)
+    return 10;
+  return 20;
+}
+
+inline size_t __klines_weight(size_t limit)
+{
+  if (limit < 100)
+    return 1;
+  if (limit < 500)
+    return 2;
+  if (limit <= 1000)
+    return 5;
+  return 10;
+}
+
+// cost_of returns the cost of sending `verb endpoint` with args, as listed in
+// https://binance-docs.github.io/apidocs/futures/en/#limits and on every
+// endpoint. Unknown endpoints weigh 1.
+inline request_cost cost_of(boost::beast::http::verb method,
+                            std::string_view endpoint, const query_args& args)
+{
+  using boost::beast::http::verb;
+
+  size_t limit    = 0;
+  bool has_limit  = args.get("limit", limit);
+  bool has_symbol = args.contains("symbol");
+
+  if (endpoint == "/fapi/v1/depth")
+    return {__depth_weight(has_limit ? limit : 500), 0};
+  if (endpoint == "/fapi/v1/klines")
+    return {__klines_weight(has_limit ? limit : 500), 0};
+  if (endpoint == "/fapi/v1/order")
+    return method == verb::post ? request_cost{0, 1} : request_cost{1, 0};
+  if (endpoint == "/fapi/v1/ticker/price"
+      || endpoint == "/fapi/v1/premiumIndex")
+    return {has_symbol ? 1u : 2u, 0};
+  if (endpoint == "/fapi/v1/allOrders")
+    return {5, 0};
+  if (endpoint == "/fapi/v1/positionSide/dual")
+    return {30, 0};
+  return {1, 0};
+}
+
+// rate_limiter keeps one budget per exchange limit and tells when a request
+// can be sent without going over any of them.
+//
+// The exchange counts in fixed windows aligned to the clock (a minute starts
+// at :00), so a budget is refilled at once when its window rolls over. The
+// usage reported in the X-MBX-USED-WEIGHT-* and X-MBX-ORDER-COUNT-* headers
+// is adopted when it is above ours: other clients on the same IP or account
+// spend the budget too. A 429 or 418 stops everything until its Retry-After.
+class rate_limiter
+{
+public:
+  using clock      = std::chrono::system_clock;
+  using time_point = clock::time_point;
+  using duration   = clock::duration;
+
+  enum class kind
+  {
+    weight,    // REQUEST_WEIGHT
+    orders,    // ORDERS
+    requests,  // RAW_REQUESTS, every request counts 1
+  };
+
+private:
+  struct bucket
+  {
+    kind kind_;
+    size_t limit_;
+    duration interval_;
+    time_point window_;  // start of the current window
+    size_t used_;
+  };
+
+  std::vector<bucket> buckets_;
+  time_point retry_after_;
+
+public:
+  rate_limiter()
+  {
+    set_defaults();
+  }
+
+  // set_defaults sets the limits of Binance Futures: 2400 weight per minute,
+  // 1200 orders per minute and 300 orders per 10 seconds.
+  void set_defaults()
+  {
+    buckets_.clear();
+    add(kind::weight, 2400, std::chrono::minutes(1));
+    add(kind::orders, 1200, std::chrono::minutes(1));
+    add(kind::orders, 300, std::chrono::seconds(10));
+  }
+
+  // set replaces the limits by the ones in exchange_info.
+  void set(const std::vector<messages::exchange_info::rate_limit>& limits)
+  {
+    buckets_.clear();
+    for (auto& rl : limits)
+    {
+      duration unit = interval_of(rl.interval);
+      if (unit == duration::zero() || rl.limit <= 0)
+        continue;
+      add(kind_of(rl.limit_type), size_t(rl.limit),
+          unit * std::max(rl.interval_num, 1));
+    }
+  }
+
+  void add(kind k, size_t limit, duration interval)
+  {
+    buckets_.push_back({k, limit, interval, time_point(), 0});
+  }
+
+  void clear()
+  {
+    buckets_.clear();
+    retry_after_ = time_point();
+  }
+
+  // wait returns how long to wait until c can be sent, zero if it can go now.
+  duration wait(const request_cost& c, time_point now = clock::now())
+  {
+    duration d = retry_after_ > now ? retry_after_ - now : duration::zero();
+    for (auto& b : buckets_)
+    {
+      roll(b, now);
+      size_t n = cost(b, c);
+      if (n > 0 && b.used_ + n > b.limit_)
+        d = std::max(d, b.window_ + b.interval_ - now);
+    }
+    return d;
+  }
+
+  // try_acquire takes c from the budgets if it can be sent now.
+  bool try_acquire(const request_cost& c, time_point now = clock::now())
+  {
+    if (wait(c, now) != duration::zero())
+      return false;
+    for (auto& b : buckets_)
+      b.used_ += cost(b, c);
+    return true;
+  }
+
+  // sync adopts the usage in the headers of a response to a request sent at
+  // `sent`, and the Retry-After of a 429 or 418.
+  template<class Fields>
+  void sync(const boost::beast::http::header<false, Fields>& res,
+            time_point sent, time_point now = clock::now())
+  {
+    for (auto& f : res)
+    {
+      sync_field(std::string_view(f.name_string().data(),
+                                  f.name_string().size()),
+                 std::string_view(f.value().data(), f.value().size()), sent,
+                 now);
+    }
+
+    auto it = res.find(boost::beast::http::field::retry_after);
+    sync_status(res.result_int(),
+                it != res.end() ? std::string_view(it->value().data(),
+                                                   it->value().size())
+                                : std::string_view(),
+                now);
+  }
+
+  // sync_field adopts the usage in one header field, if it reports any.
+  void sync_field(std::string_view name, std::string_view value,
+                  time_point sent, time_point now = clock::now())
+  {
+    if (iequals_prefix(name, "x-mbx-used-weight-"))
+      sync(kind::weight, name.substr(18), value, sent, now);
+    else if (iequals_prefix(name, "x-mbx-order-count-"))
+      sync(kind::orders, name.substr(18), value, sent, now);
+  }
+
+  // sync_status holds every request for retry_after seconds after a 429 or
+  // 418.
+  void sync_status(unsigned status, std::string_view retry_after,
+                   time_point now = clock::now())
+  {
+    if (status != 429 && status != 418)
+      return;
+    long s       = std::atol(std::string(retry_after).c_str());
+    retry_after_ =
+        std::max(retry_after_, now + std::chrono::seconds(std::max(s, 1L)));
+  }
+
+  size_t used(kind k, duration interval) const
+  {
+    for (auto& b : buckets_)
+    {
+      if (b.kind_ == k && b.interval_ == interval)
+        return b.used_;
+    }
+    return 0;
+  }
+
+  time_point retry_after() const
+  {
+    return retry_after_;
+  }
+
+private:
+  static size_t cost(const bucket& b, const request_cost& c)
+  {
+    switch (b.kind_)
+    {
+      case kind::weight:
+        return c.weight;
+      case kind::orders:
+        return c.orders;
+      default:
+        return 1;
+    }
+  }
+
+  static void roll(bucket& b, time_point now)
+  {
+    if (now < b.window_ + b.interval_)
+      return;
+    auto since = now.time_since_epoch();
+    b.window_  = time_point(since - since % b.interval_);
+    b.used_    = 0;
+  }
+
+  void sync(kind k, std::string_view interval, std::string_view value,
+            time_point sent, time_point now)
+  {
+    duration d = parse_interval(interval);
+    for (auto& b : buckets_)
+    {
+      if (b.kind_ != k || b.interval_ != d)
+        continue;
+      roll(b, now);
+      // the count of a previous window.
+      if (sent < b.window_)
+        return;
+      size_t used = size_t(std::atol(std::string(value).c_str()));
+      b.used_     = std::max(b.used_, used);
+      return;
+    }
+  }
+
+  // parse_interval parses the suffix of a header, as 1M or 10S.
+  static duration parse_interval(std::string_view s)
+  {
+    if (s.empty())
+      return duration::zero();
+    long n = std::atol(std::string(s.substr(0, s.size() - 1)).c_str());
+    return std::max(n, 1L) * interval_of(s.substr(s.size() - 1));
+  }
+
+  static duration interval_of(std::string_view s)
+  {
+    if (s.empty())
+      return duration::zero();
+    switch (s[0] | 0x20)
+    {
+      case 's':
+        return std::chrono::seconds(1);
+      case 'm':
+        return std::chrono::minutes(1);
+      case 'h':
+        return std::chrono::hours(1);
+      case 'd':
+        return std::chrono::hours(24);
+    }
+    return duration::zero();
+  }
+
+  static kind kind_of(std::string_view s)
+  {
+    if (s == "ORDERS")
+      return kind::orders;
+    if (s == "RAW_REQUESTS")
+      return kind::requests;
+    return kind::weight;
+  }
+
+  static bool iequals_prefix(std::string_view s, std::string_view prefix)
+  {
+    if (s.size() < prefix.size())
+      return false;
+    for (size_t i = 0; i < prefix.size(); i++)
+    {
+      if ((s[i] | 0x20) != prefix[i])
+        return false;
+    }
+    return true;
+  }
+};
+}  // namespace http
+}  // namespace binance
+
+#endif
@@ -6,10 +6,14 @@
 #include <binance/crypto/signer.hpp>
 #include <binance/definitions.hpp>
 #include <binance/error.hpp>
+#include <binance/http/clock_sync.hpp>
+#include <binance/http/hedging.hpp>
 #include <binance/http/messages.hpp>
+#include <binance/http/rate_limiter.hpp>
 #include <binance/json.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
 #include <boost/asio/ssl/error.hpp>
 #include <boost/asio/ssl/stream.hpp>
 #include <boost/beast/core.hpp>
@@ -20,7 +24,14 @@
 #include <boost/system/error_code.hpp>
 #include <boost/url.hpp>
 #include <boost/variant2/variant.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <deque>
 #include <list>
+#include <memory>
+#include <optional>
 #include <utility>
 #ifdef BINANCE_DEBUG
 #include <iostream>
@@ -30,7 +41,9 @@ namespace binance
 {
 namespace http
 {
+class stream;
 class __request_elem;
+struct __request_template;
 // TODO:
 class __request_visitor
 {
@@ -59,17 +72,57 @@ struct _function : public std::function<void(Arg)>
   }
 };
 
+// priority is the lane a request is queued in, see stream.
+enum class priority : size_t
+{
+  order_entry,  // new orders and cancels
+  user_data,    // account queries and listen key renewals
+  market_data,  // public market data and bulk downloads
+};
+
+constexpr size_t priority_count = 3;
+
+// ErrorHandler is called instead of the handler of a request that failed.
+using ErrorHandler = std::function<void(const binance::error&)>;
+
+// retry_policy tells how a GET is sent again after a network error, a
+// timeout or a 5xx: up to max_attempts times in all, waiting base_delay
+// before the second one and twice as long every time after, up to
+// max_delay. Orders and cancels are never sent again, their error goes to
+// their handler.
+struct retry_policy
+{
+  size_t max_attempts = 3;
+  std::chrono::milliseconds base_delay{100};
+  std::chrono::milliseconds max_delay{5000};
+
+  // delay returns the wait before attempt n (1 is the first retry).
+  std::chrono::milliseconds delay(size_t n) const
+  {
+    auto d = base_delay;
+    for (size_t i = 1; i < n && d < max_delay; i++)
+      d *= 2;
+    return std::min(d, max_delay);
+  }
+};
+
+// __hedge is shared by a request and its hedged copy: the first answer is
+// taken, the other one dropped.
+struct __hedge
+{
+  size_t pending = 1;  // copies in flight
+  bool done      = false;
+};
+
 struct __request_elem
 {
-  boost::variant2::variant<
-      std::shared_ptr<
-          boost::beast::http::request<boost::beast::http::empty_body>>,
-      std::shared_ptr<
-          boost::beast::http::request<boost::beast::http::string_body>>>
-      req_;
+  // the request as written, see __request_template.
+  std::string wire_;
+  boost::beast::http::verb method_;
   void* message_;
   boost::variant2::variant<
       _function<messages::get_position_mode*>, _function<messages::kline_data*>,
+      _function<messages::kline_series_data*>,
       _function<messages::listen_key*>, _function<messages::empty_args*>,
       _function<messages::place_order*>, _function<messages::cancel_order*>,
       _function<messages::orderbook*>, _function<messages::exchange_info*>,
@@ -77,27 +130,82 @@ struct __request_elem
       _function<messages::price_ticker*>,
       _function<messages::cancel_order_all*>,
       _function<messages::current_open_order*>,
-      _function<messages::current_open_order_all*>>
+      _function<messages::current_open_order_all*>,
+      _function<messages::server_time*>>
       cb_;
-
-  template<typename Body, typename T>
-  explicit __request_elem(
-      std::shared_ptr<boost::beast::http::request<Body>> req, T* tok,
-      std::function<void(T*)> cb)
-      : req_(req)
+  ErrorHandler on_error_;
+  priority lane_;
+  request_cost cost_;
+  rate_limiter::time_point sent_;
+  // attempts_ is the number of times it was sent and failed, not_before_
+  // when it can be sent again.
+  size_t attempts_;
+  rate_limiter::time_point not_before_;
+  uint64_t id_;
+  rate_limiter::time_point deadline_;
+  // cancelled_ drops the response of a request cancelled in flight.
+  bool cancelled_;
+  std::shared_ptr<__hedge> hedge_;
+  // sign_ writes wire_ from template_ with a fresh timestamp and signature,
+  // each time the request is sent. Null for requests that aren't signed.
+  const __request_template* template_;
+  void (stream::*sign_)(__request_elem&);
+
+  template<typename T>
+  explicit __request_elem(std::string&& wire, boost::beast::http::verb method,
+                          T* tok, std::function<void(T*)> cb,
+                          ErrorHandler on_error = {},
+                          priority lane         = priority::market_data)
+      : wire_(std::move(wire))
+      , method_(method)
       , message_(tok)
       , cb_(cb)
+      , on_error_(std::move(on_error))
+      , lane_(lane)
+      , attempts_(0)
+      , id_(0)
+      , deadline_(rate_limiter::time_point::max())
+      , cancelled_(false)
+      , template_(nullptr)
+      , sign_(nullptr)
   {
   }
   __request_elem(const __request_elem&) = default;
 
-  void operator()(const json::value& jv)
+  // is_idempotent returns true for GETs, which can be sent again if the
+  // connection closes before their response.
+  bool is_idempotent() const
+  {
+    return method_ == boost::beast::http::verb::get;
+  }
+
+  // decode reads jv into the message, returning an error if it doesn't fit.
+  binance::error decode(const json::value& jv)
+  {
+    try
+    {
+      boost::variant2::visit(
+          [this, &jv](auto& cb) {
+            *static_cast<typename std::decay_t<decltype(cb)>::arg_type>(
+                message_) = jv;
+          },
+          cb_);
+    }
+    catch (const simdjson::simdjson_error& ex)
+    {
+      return binance::error(binance::error::kind::decode, int(ex.error()),
+                            ex.what());
+    }
+    return {};
+  }
+
+  // operator() calls the handler with the decoded message.
+  void operator()()
   {
     boost::variant2::visit(
-        [this, &jv](auto cb) {
-          auto v = static_cast<typename decltype(cb)::arg_type>(message_);
-          *v     = jv;
-          cb(v);
+        [this](auto& cb) {
+          cb(static_cast<typename std::decay_t<decltype(cb)>::arg_type>(
+              message_));
         },
         cb_);
   }
@@ -106,6 +214,19 @@ struct __request_elem
 template<typename T>
 using DefaultHandler = std::function<void(T*)>;
 
+// __request_template holds the bytes of a request that are the same on every
+// call: the request line up to the target and the header fields. Only the
+// query (or form body) and its Content-Length are written per call.
+struct __request_template
+{
+  boost::beast::http::verb method_;
+  std::string endpoint_;
+  int code_;  // __SECURITY_CODES
+  bool has_body_;
+  std::string head_;    // "GET /fapi/v1/depth"
+  std::string fields_;  // " HTTP/1.1\r\nHost: ...\r\n" up to the last field
+};
+
 // TODO: Maybe add compatibility with Boost 1.67 ????
 using http_stream_t =
     std::optional<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>;
@@ -119,29 +240,259 @@ enum __SECURITY_CODES
   MARKET_DATA
 };
 
+template<__SECURITY_CODES C>
+constexpr priority __priority_of()
+{
+  if constexpr (C == __SECURITY_CODES::TRADE)
+    return priority::order_entry;
+  else if constexpr (C == __SECURITY_CODES::USER_DATA
+                     || C == __SECURITY_CODES::USER_STREAM)
+    return priority::user_data;
+  else
+    return priority::market_data;
+}
+
+// __is_disconnect returns true if ec means the server closed the connection.
+inline bool __is_disconnect(boost::system::error_code const& ec)
+{
+  namespace net = boost::asio;
+  return ec == net::error::eof || ec == net::error::connection_reset
+         || ec == net::error::broken_pipe
+         || ec == boost::beast::http::error::end_of_stream
+         || ec == net::ssl::error::stream_truncated;
+}
+
+// __error_of returns the error of a request ended by e, as timed_out.
+inline binance::error __error_of(boost::asio::error::basic_errors e)
+{
+  return binance::error(boost::asio::error::make_error_code(e));
+}
+
+// __response_parser parses the header of a response without storing its
+// fields: the rate limit ones go to the limiter as they are parsed and the
+// rest are skipped. The body goes to a padded_buffer owned by the
+// connection, see stream::on_read_header.
+class __response_parser : public boost::beast::http::basic_parser<false>
+{
+  using string_view = boost::beast::string_view;
+  using error_code  = boost::beast::error_code;
+
+  padded_buffer& body_;
+  rate_limiter& limiter_;
+  rate_limiter::time_point sent_;
+  unsigned status_;
+  std::string retry_after_;
+
+public:
+  __response_parser(padded_buffer& body, rate_limiter& limiter,
+                    rate_limiter::time_point sent)
+      : body_(body)
+      , limiter_(limiter)
+      , sent_(sent)
+      , status_(0)
+  {
+  }
+
+  unsigned status() const
+  {
+    return status_;
+  }
+
+private:
+  void append(string_view s)
+  {
+    auto b = body_.prepare(s.size());
+    std::memcpy(b.data(), s.data(), s.size());
+    body_.commit(s.size());
+  }
+
+  void on_request_impl(boost::beast::http::verb, string_view, string_view, int,
+                       error_code&) override
+  {
+  }
+  void on_response_impl(int code, string_view, int, error_code&) override
+  {
+    status_ = unsigned(code);
+  }
+  void on_field_impl(boost::beast::http::field f, string_view name,
+                     string_view value, error_code&) override
+  {
+    std::string_view v(value.data(), value.size());
+    if (f == boost::beast::http::field::retry_after)
+      retry_after_.assign(v);
+    else if (f == boost::beast::http::field::unknown)
+      limiter_.sync_field(std::string_view(name.data(), name.size()), v, sent_);
+  }
+  // a 429 or 418 holds the requests even without a Retry-After.
+  void on_header_impl(error_code&) override
+  {
+    limiter_.sync_status(status_, retry_after_);
+  }
+  void on_body_init_impl(boost::optional<std::uint64_t> const& n,
+                         error_code&) override
+  {
+    if (n)
+      body_.reserve(body_.size() + size_t(*n));
+  }
+  size_t on_body_impl(string_view s, error_code&) override
+  {
+    append(s);
+    return s.size();
+  }
+  void on_chunk_header_impl(std::uint64_t, string_view, error_code&) override
+  {
+  }
+  size_t on_chunk_body_impl(std::uint64_t, string_view s, error_code&) override
+  {
+    append(s);
+    return s.size();
+  }
+  void on_finish_impl(error_code&) override
+  {
+  }
+};
+
+// __connection is one keep-alive connection of a stream, with the requests
+// written to it and not answered yet.
+struct __connection
+{
+  http_stream_t stream_;
+  // incremented on close, so handlers of a previous connection are ignored.
+  size_t gen_;
+  boost::beast::flat_buffer buffer_;
+  // body_ keeps its storage across responses.
+  padded_buffer body_;
+  std::optional<__response_parser> parser_;
+  boost::asio::deadline_timer timeout_;
+  // hedges the request at the front, see hedge_policy.
+  boost::asio::deadline_timer hedge_timer_;
+  std::list<__request_elem> in_flight_;
+  bool is_open_;
+  bool is_connecting_;
+  bool is_writing_;
+  bool is_reading_;
+  bool timed_out_;    // cancelled by timeout_
+  size_t responses_;  // read since connected
+  size_t failures_;   // connects failed in a row
+
+  __connection(binance::io_context& ioc)
+      : gen_(0)
+      , timeout_(ioc)
+      , hedge_timer_(ioc)
+      , is_open_(false)
+      , is_connecting_(false)
+      , is_writing_(false)
+      , is_reading_(false)
+      , timed_out_(false)
+      , responses_(0)
+      , failures_(0)
+  {
+  }
+
+  bool is_open() const
+  {
+    return stream_ && stream_->next_layer().is_open() && is_open_;
+  }
+
+  bool is_idle() const
+  {
+    return is_open() && !is_writing_ && in_flight_.empty();
+  }
+};
+
+
+// request_handle is returned by the requests of a stream, to set their
+// deadline or cancel them:
+//
+//   api.async_read(ob, cb, on_error).expires_after(std::chrono::seconds(2));
+class request_handle
+{
+  stream* s_;
+  uint64_t id_;
+
+public:
+  request_handle()
+      : s_(nullptr)
+      , id_(0)
+  {
+  }
+  request_handle(stream* s, uint64_t id)
+      : s_(s)
+      , id_(id)
+  {
+  }
+  uint64_t id() const
+  {
+    return id_;
+  }
+  // expires_after completes the request with timed_out if it isn't answered
+  // within d.
+  request_handle& expires_after(rate_limiter::duration d);
+  request_handle& expires_at(rate_limiter::time_point t);
+  // cancel completes the request with operation_aborted, right away if it
+  // wasn't sent yet (returning true), when its response arrives otherwise.
+  bool cancel();
+};
+
 class stream
 {
   binance::io_context& ioc_;
   boost::asio::ssl::context ctx_;
-  http_stream_t stream_;
   boost::urls::url base_url_;
-  boost::asio::deadline_timer timeout_;
+  boost::asio::ip::tcp::resolver resolver_;
   boost::asio::ip::tcp::resolver::results_type resolve_results_;
+  // connections waiting for the host to be resolved, with their gen_.
+  std::vector<std::pair<__connection*, size_t>> resolving_;
+  // incremented by close(), so a lookup it cancelled leaves resolving_ alone.
+  size_t resolve_gen_;
   auth_opts auth_;
-  // TODO: One buffer and one parser per stream?
-  boost::beast::flat_buffer buffer_;
+  // signs with auth_.secret.
+  crypto::signer signer_;
   json::parser parser_;
 
   std::vector<boost::asio::deadline_timer> timers_;
 
-  bool is_open_;
-  std::list<__request_elem> queue_;
-  boost::beast::http::response<boost::beast::http::string_body> response_;
-  bool is_writing_;
-
-  size_t req_count_;
-  size_t rate_limit_;
-  int limit_window_;
+  // requests wait here, one queue per priority, until a connection is
+  // ready. A lane passed over starvation_limit_ times in a row goes next.
+  std::array<std::list<__request_elem>, priority_count> queues_;
+  std::array<size_t, priority_count> skipped_;
+  size_t starvation_limit_;
+  priority failed_lane_;
+  // templates_ are serialized on first use, build_request writes requests
+  // from them into strings recycled from spare_.
+  std::deque<__request_template> templates_;
+  std::vector<std::string> spare_;
+  std::string path_;
+  std::string query_;
+  // the first pool_size_ connections are used. Connections are never freed,
+  // pending handlers may point to them.
+  std::vector<std::unique_ptr<__connection>> conns_;
+  size_t pool_size_;
+  // standby_ keeps conns_[pool_size_] connected, to replace one that closes.
+  bool standby_;
+  size_t pipeline_depth_;
+
+  rate_limiter limiter_;
+  // wakes next_async_request up when the budget allows the next request.
+  boost::asio::deadline_timer limit_timer_;
+
+  retry_policy retry_;
+  ErrorHandler on_error_;
+
+  uint64_t next_id_;
+  // a request in flight longer than this fails with timed_out.
+  rate_limiter::duration request_timeout_;
+  // completes queued requests when their deadline passes.
+  boost::asio::deadline_timer expiry_timer_;
+  rate_limiter::time_point expiry_at_;
+
+  hedge_policy hedge_;
+  // response times of market data GETs.
+  latency_window latencies_;
+
+  // the exchange clock, sampled by the pings when time_sync_ is set.
+  clock_sync clock_;
+  bool time_sync_;
 
 public:
   stream()               = delete;
@@ -160,29 +511,112 @@ public:
   bool is_open() const;
   bool is_busy() const;
   void discard_next();
+  // Requests are sent within the limits of the exchange, weighting each one
+  // as documented (an `orderbook` of 1000 levels weighs 20). The defaults are
+  // the ones of Binance Futures; set_rate_limits takes the ones in
+  // exchange_info, which async_read(exchange_info*) applies too. The usage
+  // reported in the headers of every response is followed, and a 429 or 418
+  // holds every request until its Retry-After.
+  void set_rate_limits(
+      const std::vector<messages::exchange_info::rate_limit>& limits);
+  // set_rate_limit adds a limit of `limit` requests every `window` seconds.
   void set_rate_limit(size_t limit, int window);
+  rate_limiter& limiter();
+  // set_pool_size sets the number of connections opened by async_connect
+  // (1 by default). Queued requests go to the first idle connection, so up to
+  // n of them are in flight at once and a slow response only holds up its
+  // own connection. Callbacks may then run out of order.
+  void set_pool_size(size_t n);
+  size_t pool_size() const;
+  // set_standby keeps one more connection open and handshaken, not used for
+  // requests: when a connection of the pool closes it takes its place at
+  // once, so no request waits for a connect.
+  void set_standby(bool enabled);
+  // set_pipeline_depth lets up to k GETs be written on a connection before
+  // their responses arrive (1 by default, no pipelining). Responses come back
+  // in order. If the server closes the connection, the GETs not answered are
+  // queued again. Other requests wait for an idle connection.
+  void set_pipeline_depth(size_t k);
+  size_t pipeline_depth() const;
+  // Requests are queued by priority: orders (place_order, cancel_order...)
+  // first, then user data (account queries, listen key), then market data.
+  // set_starvation_limit bounds how many requests in a row may go before a
+  // waiting lower priority one (16 by default). With more than one
+  // connection, one is always kept for orders.
+  void set_starvation_limit(size_t n);
+  size_t queued(priority p) const;
+  // The stream never throws: a request that fails calls the ErrorHandler
+  // passed with it, or else the one of set_error_handler, which gets the
+  // connection errors too. Before that, GETs are sent again as
+  // set_retry_policy says. Connections are opened again with its backoff.
+  void set_error_handler(ErrorHandler h);
+  void set_retry_policy(const retry_policy& p);
+  const retry_policy& get_retry_policy() const;
+  // Every request returns a request_handle. A request may be given a
+  // deadline, after which it completes with timed_out whether it was sent
+  // or not; set_request_timeout bounds the wait for a response once it is
+  // sent (15 seconds by default).
+  void set_request_timeout(rate_limiter::duration d);
+  void set_deadline(uint64_t id, rate_limiter::time_point t);
+  bool cancel(uint64_t id);
+  // set_hedge_policy enables hedged reads of market data GETs, sent again on
+  // another idle connection when slower than most. It needs a pool of 3
+  // connections or more: the last idle one is kept for orders.
+  void set_hedge_policy(const hedge_policy& p);
+  const latency_window& latencies() const;
+  // set_time_sync follows the exchange clock: the pings of idle connections
+  // read /fapi/v1/time instead, and the timestamp of signed requests is
+  // taken from clock() (the local clock until the first sample).
+  void set_time_sync(bool enabled);
+  const clock_sync& clock() const;
+  // set_parser_policy bounds the memory of the parser of the responses, see
+  // json::capacity_policy. parser_stats tells the largest response parsed.
+  void set_parser_policy(const json::capacity_policy& p);
+  const json::parser_stats& parser_stats() const;
+  // timestamp returns the timestamp of a signed request, in milliseconds.
+  // Signed requests are stamped and signed as they are written, so the time
+  // they wait in the queue, and each retry, get a fresh one.
+  int64_t timestamp() const;
   void async_connect();
   template<typename T, class... Args>
-  void async_read(DefaultHandler<T>, Args... args);
+  request_handle async_read(DefaultHandler<T>, Args... args);
   template<typename T, class... Args>
-  void async_write(DefaultHandler<T>, Args... args);
-
-  void async_read(messages::get_position_mode*,
-                  DefaultHandler<messages::get_position_mode>);
-  void async_read(messages::listen_key*, DefaultHandler<messages::listen_key>);
-  void async_read(messages::exchange_info*,
-                  DefaultHandler<messages::exchange_info>);
-  void async_read(messages::orderbook*, DefaultHandler<messages::orderbook>);
-  void async_read(messages::recent_trades*,
-                  DefaultHandler<messages::recent_trades>);
+  request_handle async_write(DefaultHandler<T>, Args... args);
+
+  request_handle async_read(messages::get_position_mode*,
+                            DefaultHandler<messages::get_position_mode>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::server_time*,
+                            DefaultHandler<messages::server_time>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::listen_key*,
+                            DefaultHandler<messages::listen_key>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::exchange_info*,
+                            DefaultHandler<messages::exchange_info>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::orderbook*,
+                            DefaultHandler<messages::orderbook>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::recent_trades*,
+                            DefaultHandler<messages::recent_trades>,
+                            ErrorHandler = {});
   // https://binance-docs.github.io/apidocs/futures/en/#old-trades-lookup-market_data
   // https://binance-docs.github.io/apidocs/futures/en/#compressed-aggregate-trades-list
-  void async_read(messages::kline_data*, DefaultHandler<messages::kline_data>);
-  void async_read(messages::mark_price*, DefaultHandler<messages::mark_price>);
+  request_handle async_read(messages::kline_data*,
+                            DefaultHandler<messages::kline_data>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::kline_series_data*,
+                            DefaultHandler<messages::kline_series_data>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::mark_price*,
+                            DefaultHandler<messages::mark_price>,
+                            ErrorHandler = {});
   // https://binance-docs.github.io/apidocs/futures/en/#get-funding-rate-history
   // https://binance-docs.github.io/apidocs/futures/en/#24hr-ticker-price-change-statistics
-  void async_read(messages::price_ticker*,
-                  DefaultHandler<messages::price_ticker>);
+  request_handle async_read(messages::price_ticker*,
+                            DefaultHandler<messages::price_ticker>,
+                            ErrorHandler = {});
   // https://binance-docs.github.io/apidocs/futures/en/#symbol-order-book-ticker
   // https://binance-docs.github.io/apidocs/futures/en/#get-all-liquidation-orders
   // https://binance-docs.github.io/apidocs/futures/en/#open-interest
@@ -197,20 +631,28 @@ public:
   // https://binance-docs.github.io/apidocs/futures/en/#get-future-account-transaction-history-list-user_data
   // https://binance-docs.github.io/apidocs/futures/en/#change-position-mode-trade
   // https://binance-docs.github.io/apidocs/futures/en/#get-current-position-mode-user_data
-  void async_write(messages::place_order*,
-                   DefaultHandler<messages::place_order>);
+  request_handle async_write(messages::place_order*,
+                             DefaultHandler<messages::place_order>,
+                             ErrorHandler = {});
+  // make_order_template returns a template of the arguments of shared, signed
+  // with the key of this stream. See order_template.
+  order_template make_order_template(const messages::place_order& shared);
   // https://binance-docs.github.io/apidocs/futures/en/#place-multiple-orders-trade
   // https://binance-docs.github.io/apidocs/futures/en/#query-order-user_data
-  void async_write(messages::cancel_order*,
-                   DefaultHandler<messages::cancel_order>);
-  void async_write(messages::cancel_order_all*,
-                   DefaultHandler<messages::cancel_order_all>);
+  request_handle async_write(messages::cancel_order*,
+                             DefaultHandler<messages::cancel_order>,
+                             ErrorHandler = {});
+  request_handle async_write(messages::cancel_order_all*,
+                             DefaultHandler<messages::cancel_order_all>,
+                             ErrorHandler = {});
   // https://binance-docs.github.io/apidocs/futures/en/#cancel-multiple-orders-trade
   // https://binance-docs.github.io/apidocs/futures/en/#auto-cancel-all-open-orders-trade
-  void async_read(messages::current_open_order*,
-                  DefaultHandler<messages::current_open_order>);
-  void async_read(messages::current_open_order_all*,
-                  DefaultHandler<messages::current_open_order_all>);
+  request_handle async_read(messages::current_open_order*,
+                            DefaultHandler<messages::current_open_order>,
+                            ErrorHandler = {});
+  request_handle async_read(messages::current_open_order_all*,
+                            DefaultHandler<messages::current_open_order_all>,
+                            ErrorHandler = {});
   // https://binance-docs.github.io/apidocs/futures/en/#all-orders-user_data
   // https://binance-docs.github.io/apidocs/futures/en/#futures-account-balance-v2-user_data
   // https://binance-docs.github.io/apidocs/futures/en/#account-information-v2-user_data
@@ -227,107 +669,431 @@ public:
   // https://binance-docs.github.io/apidocs/futures/en/#user-api-trading-quantitative-rules-indicators-user_data
 
   // renew_listen_key sets up a timer to renew the listen_key automatically
-  // for the WebSocket User Data Streams.
-  void renew_listen_key();
+  // for the WebSocket User Data Streams. A failed renewal is tried again a
+  // minute later.
+  void renew_listen_key(
+      boost::posix_time::time_duration after = boost::posix_time::minutes(59));
 
 private:
   // ping every 15 seconds.
   void ping_timer();
-  void rate_timer();
   // clear all the timers that expired
   void clear_timers();
-  void on_connect(boost::system::error_code const&,
+  void close(__connection*);
+  // size returns the number of connections in use, the standby included.
+  size_t size() const;
+  void connect(__connection*);
+  // resolve looks the host up, then connects the connections waiting.
+  void resolve();
+  // replace opens c again. A standby connection takes its place meanwhile.
+  void replace(__connection* c);
+  void on_connect(__connection*, size_t gen, boost::system::error_code const&,
                   const boost::asio::ip::tcp::endpoint&);
-  void on_write(boost::system::error_code const&, size_t);
-  void on_read(boost::system::error_code const&, size_t);
+  void connect_failed(__connection* c, boost::system::error_code const& ec);
+  void on_handshake(__connection*, size_t gen,
+                    boost::system::error_code const&);
+  void on_write(__connection*, size_t gen, boost::system::error_code const&,
+                size_t);
+  void on_read_header(__connection*, size_t gen,
+                      boost::system::error_code const&, size_t);
+  void on_read_body(__connection*, size_t gen, boost::system::error_code const&,
+                    size_t);
+  void on_read(__connection*, size_t gen, boost::system::error_code const&,
+               size_t);
+  // on_response goes on with c after the response at its front was handled.
+  void on_response(__connection* c, bool keep_alive);
+  // fail gives the requests in flight on c back to the queue.
+  void fail(__connection* c);
+  // abort ends the requests in flight on c after ec and opens it again.
+  void abort(__connection* c, boost::system::error_code const& ec);
+  // reconnect opens c again after the backoff of its failures.
+  void reconnect(__connection* c);
+  void requeue(std::list<__request_elem>& from,
+               std::list<__request_elem>::iterator it);
+  // retry gives it back to the queue to be sent after the retry delay.
+  void retry(std::list<__request_elem>& from,
+             std::list<__request_elem>::iterator it);
+  bool can_retry(const __request_elem& e) const;
+  // complete removes it and calls its error handler with err.
+  void complete(std::list<__request_elem>& from,
+                std::list<__request_elem>::iterator it,
+                const binance::error& err);
+  void report(const binance::error& err);
+  bool settle(std::list<__request_elem>& from,
+              std::list<__request_elem>::iterator it);
+  bool settle_failed(std::list<__request_elem>& from,
+                     std::list<__request_elem>::iterator it, unsigned code);
+  void arm_expiry(rate_limiter::time_point t);
+  void expire_queued();
+  void arm_hedge(__connection* c);
+  void hedge(__connection* c);
+  // response_error returns the error of a response with status code.
+  binance::error response_error(unsigned code, const padded_buffer& body);
+  // ready_connection returns the connection e should be written to, if any.
+  __connection* ready_connection(const __request_elem& e);
   really_inline void next_async_request();
-  template<class T>
-  really_inline void do_write(boost::beast::http::request<T>&);
+  void arm_limit_timer(rate_limiter::duration d);
+  really_inline void write(__connection*);
+  really_inline void read(__connection*);
+  really_inline void arm_timeout(__connection*);
   template<class ReqBody, class Msg, __SECURITY_CODES C>
-  void async_call(std::shared_ptr<boost::beast::http::request<ReqBody>> req,
-                  Msg* msg, DefaultHandler<Msg> cb);
+  request_handle async_call(boost::beast::http::verb method,
+                            std::string_view endpoint, Msg* msg,
+                            DefaultHandler<Msg> cb, ErrorHandler on_error);
   template<class ReqBody, __SECURITY_CODES C, class Msg>
-  void async_get(const std::string& endpoint, Msg* msg, DefaultHandler<Msg> cb);
+  request_handle async_get(std::string_view endpoint, Msg* msg,
+                           DefaultHandler<Msg> cb, ErrorHandler on_error = {});
   template<class ReqBody, __SECURITY_CODES C, class Msg>
-  void async_post(const std::string& endpoint, Msg* msg,
-                  DefaultHandler<Msg> cb);
+  request_handle async_post(std::string_view endpoint, Msg* msg,
+                            DefaultHandler<Msg> cb, ErrorHandler on_error = {});
   template<class ReqBody, __SECURITY_CODES C, class Msg>
-  void async_del(const std::string& endpoint, Msg* msg, DefaultHandler<Msg> cb);
+  request_handle async_del(std::string_view endpoint, Msg* msg,
+                           DefaultHandler<Msg> cb, ErrorHandler on_error = {});
   template<class ReqBody, __SECURITY_CODES C, class Msg>
-  void async_put(const std::string& endpoint, Msg* msg, DefaultHandler<Msg> cb);
-  template<class BodyType, class Msg, __SECURITY_CODES C>
-  void prepare_request(boost::beast::http::request<BodyType>&, Msg* msg);
+  request_handle async_put(std::string_view endpoint, Msg* msg,
+                           DefaultHandler<Msg> cb, ErrorHandler on_error = {});
+  // request_template returns the template of `method endpoint`, serialized
+  // the first time it is used.
+  template<class ReqBody, __SECURITY_CODES C>
+  const __request_template& request_template(boost::beast::http::verb method,
+                                             std::string_view endpoint);
+  // build_request writes the request of msg from t into a recycled string.
+  template<class Msg, __SECURITY_CODES C>
+  std::string build_request(const __request_template& t, Msg* msg);
+  // sign writes e again as it is sent, see __request_elem::sign_.
+  template<class Msg, __SECURITY_CODES C>
+  void sign(__request_elem& e);
+  // recycle keeps the storage of a request that was answered.
+  really_inline void recycle(std::string&& wire);
   really_inline void get_error_codes(binance::error&, const json::value&);
   template<class JSONValue>
   really_inline void parse_response(binance::error& ec, JSONValue& v,
                                     const std::string& body);
-  really_inline void async_ping();
-  really_inline void enable_writing();
-  really_inline void disable_writing();
+  really_inline void async_ping(__connection*);
+  // write_direct writes a GET of msg to c, as sent at now.
+  template<class Msg>
+  void write_direct(__connection* c, std::string_view endpoint, Msg* msg,
+                    DefaultHandler<Msg> cb, rate_limiter::time_point now);
+  really_inline void enable_writing(__connection*);
+  really_inline void disable_writing(__connection*);
 };
 
 stream::stream(binance::io_context& ioc, auth_opts opts,
                const std::string& base_url,
                boost::asio::ssl::context::method method)
     : ioc_(ioc)
-    , timeout_(ioc)
-    , base_url_(base_url)
     , ctx_(method)
+    , base_url_(base_url)
+    , resolver_(ioc)
+    , resolve_gen_(0)
     , auth_(opts)
-    , is_open_(false)
-    , is_writing_(false)
-    , rate_limit_(0)
-    , req_count_(0)
-    , limit_window_(0)
+    , signer_(auth_.secret)
+    , skipped_{}
+    , starvation_limit_(16)
+    , failed_lane_(priority::order_entry)
+    , pool_size_(1)
+    , standby_(false)
+    , pipeline_depth_(1)
+    , limit_timer_(ioc)
+    , next_id_(1)
+    , request_timeout_(std::chrono::seconds(15))
+    , expiry_timer_(ioc)
+    , expiry_at_(rate_limiter::time_point::max())
+    , time_sync_(false)
 {
 }
 
 stream::~stream()
 {
   // avoid exceptions using error_code
-  if (stream_)
-    close();
+  close();
+}
+
+void stream::set_rate_limits(
+    const std::vector<messages::exchange_info::rate_limit>& limits)
+{
+  limiter_.set(limits);
 }
 
 void stream::set_rate_limit(size_t limit, int window)
 {
-  rate_limit_   = limit;
-  limit_window_ = window;
-  rate_timer();
+  limiter_.add(rate_limiter::kind::requests, limit,
+               std::chrono::seconds(std::max(window, 1)));
 }
 
-void stream::close()
+rate_limiter& stream::limiter()
+{
+  return limiter_;
+}
+
+void stream::set_pool_size(size_t n)
+{
+  pool_size_ = std::max(n, size_t(1));
+}
+
+size_t stream::pool_size() const
+{
+  return pool_size_;
+}
+
+void stream::set_standby(bool enabled)
+{
+  standby_ = enabled;
+}
+
+void stream::set_pipeline_depth(size_t k)
+{
+  pipeline_depth_ = std::max(k, size_t(1));
+}
+
+size_t stream::pipeline_depth() const
+{
+  return pipeline_depth_;
+}
+
+void stream::set_starvation_limit(size_t n)
+{
+  starvation_limit_ = std::max(n, size_t(1));
+}
+
+size_t stream::queued(priority p) const
+{
+  return queues_[size_t(p)].size();
+}
+
+void stream::set_error_handler(ErrorHandler h)
+{
+  on_error_ = std::move(h);
+}
+
+void stream::set_retry_policy(const retry_policy& p)
+{
+  retry_              = p;
+  retry_.max_attempts = std::max(p.max_attempts, size_t(1));
+}
+
+const retry_policy& stream::get_retry_policy() const
+{
+  return retry_;
+}
+
+void stream::set_request_timeout(rate_limiter::duration d)
+{
+  request_timeout_ = d;
+}
+
+void stream::set_hedge_policy(const hedge_policy& p)
+{
+  hedge_ = p;
+}
+
+void stream::set_time_sync(bool enabled)
+{
+  time_sync_ = enabled;
+  if (!time_sync_)
+    return;
+  for (size_t i = 0; i < size() && i < conns_.size(); i++)
+  {
+    if (conns_[i]->is_idle())
+      async_ping(conns_[i].get());
+  }
+}
+
+const clock_sync& stream::clock() const
+{
+  return clock_;
+}
+
+void stream::set_parser_policy(const json::capacity_policy& p)
+{
+  parser_ = json::parser(p);
+}
+
+const json::parser_stats& stream::parser_stats() const
+{
+  return parser_.stats();
+}
+
+int64_t stream::timestamp() const
+{
+  return clock_.timestamp();
+}
+
+const latency_window& stream::latencies() const
+{
+  return latencies_;
+}
+
+// set_deadline sets the deadline of the request id, queued or in flight.
+void stream::set_deadline(uint64_t id, rate_limiter::time_point t)
+{
+  for (auto& q : queues_)
+  {
+    for (auto& e : q)
+    {
+      if (e.id_ == id)
+      {
+        e.deadline_ = t;
+        arm_expiry(t);
+        return;
+      }
+    }
+  }
+  for (auto& c : conns_)
+  {
+    for (auto& e : c->in_flight_)
+    {
+      if (e.id_ == id)
+      {
+        e.deadline_ = t;
+        arm_timeout(c.get());
+      }
+    }
+  }
+}
+
+bool stream::cancel(uint64_t id)
+{
+  for (auto& q : queues_)
+  {
+    for (auto it = q.begin(); it != q.end(); ++it)
+    {
+      if (it->id_ == id)
+      {
+        complete(q, it, __error_of(boost::asio::error::operation_aborted));
+        return true;
+      }
+    }
+  }
+  for (auto& c : conns_)
+  {
+    for (auto& e : c->in_flight_)
+    {
+      if (e.id_ == id)
+        e.cancelled_ = true;
+    }
+  }
+  return false;
+}
+
+// arm_expiry calls expire_queued at t, unless it is called before.
+void stream::arm_expiry(rate_limiter::time_point t)
+{
+  if (t >= expiry_at_)
+    return;
+  expiry_at_ = t;
+  auto d     = std::chrono::duration_cast<std::chrono::milliseconds>(
+      t - rate_limiter::clock::now());
+  expiry_timer_.expires_from_now(
+      boost::posix_time::milliseconds(std::max<int64_t>(d.count(), 0) + 1));
+  expiry_timer_.async_wait([this](boost::system::error_code ec) {
+    if (!ec)
+      expire_queued();
+  });
+}
+
+// expire_queued completes the queued requests past their deadline.
+void stream::expire_queued()
+{
+  auto now   = rate_limiter::clock::now();
+  auto next  = rate_limiter::time_point::max();
+  expiry_at_ = rate_limiter::time_point::max();
+  for (auto& q : queues_)
+  {
+    for (auto it = q.begin(); it != q.end();)
+    {
+      auto e = it++;
+      if (e->deadline_ <= now)
+        complete(q, e, __error_of(boost::asio::error::timed_out));
+      else
+        next = std::min(next, e->deadline_);
+    }
+  }
+  if (next != rate_limiter::time_point::max())
+    arm_expiry(next);
+}
+
+void stream::close(__connection* c)
 {
   binance::boost_error ec;
 
-  stream_->shutdown(ec);
-  stream_->next_layer().close();
-  timers_.clear();
+  disable_writing(c);
+  c->hedge_timer_.cancel();
+  if (c->stream_)
+  {
+    c->stream_->shutdown(ec);
+    c->stream_->next_layer().close();
+  }
+  c->gen_++;
+  c->is_open_       = false;
+  c->is_connecting_ = false;
+  c->is_reading_    = false;
+  c->timed_out_     = false;
+}
 
-  is_open_ = false;
+void stream::close()
+{
+  for (auto& c : conns_)
+    close(c.get());
+  timers_.clear();
+  resolver_.cancel();
+  resolving_.clear();
+  resolve_gen_++;
+  limit_timer_.cancel();
+  expiry_timer_.cancel();
+  expiry_at_ = rate_limiter::time_point::max();
 }
 
 void stream::reset()
 {
-  if (stream_)
-    close();
-  stream_.emplace(ioc_, ctx_);
+  close();
+  while (conns_.size() < size())
+    conns_.push_back(std::make_unique<__connection>(ioc_));
+}
+
+size_t stream::size() const
+{
+  return pool_size_ + (standby_ ? 1 : 0);
 }
 
+// is_busy returns true if every connection has a request in flight.
 bool stream::is_busy() const
 {
-  return is_writing_;
+  for (size_t i = 0; i < pool_size_ && i < conns_.size(); i++)
+  {
+    if (!conns_[i]->is_writing_ && conns_[i]->in_flight_.empty())
+      return false;
+  }
+  return !conns_.empty();
 }
 
+// discard_next drops the request that failed last, or else the next one.
 void stream::discard_next()
 {
-  if (!queue_.empty())
-    queue_.pop_front();
+  auto& failed = queues_[size_t(failed_lane_)];
+  if (!failed.empty())
+  {
+    failed.pop_front();
+    return;
+  }
+  for (auto& q : queues_)
+  {
+    if (!q.empty())
+    {
+      q.pop_front();
+      return;
+    }
+  }
 }
 
 bool stream::is_open() const
 {
-  return stream_ && stream_->next_layer().is_open() && is_open_;
+  for (auto& c : conns_)
+  {
+    if (c->is_open())
+      return true;
+  }
+  return false;
 }
 
 void stream::clear_timers()
@@ -344,22 +1110,39 @@ void stream::clear_timers()
   }
 }
 
-void stream::disable_writing()
+void stream::disable_writing(__connection* c)
 {
-  is_writing_ = false;
-  timeout_.cancel();
+  c->is_writing_ = false;
+  c->is_reading_ = false;
+  c->timeout_.cancel();
 }
 
-void stream::enable_writing()
+void stream::enable_writing(__connection* c)
 {
-  is_writing_ = true;
-  req_count_++;
+  c->is_writing_ = true;
+  arm_timeout(c);
+}
 
-  timeout_.cancel();
-  timeout_.expires_from_now(boost::posix_time::seconds(15));
-  timeout_.async_wait([&](boost::system::error_code ec) {
-    if (!ec && is_writing_)
-      stream_->next_layer().cancel();
+// arm_timeout cancels the operations of c when the first request in flight
+// reaches its deadline, or request_timeout_ after it was sent.
+really_inline void stream::arm_timeout(__connection* c)
+{
+  auto now = rate_limiter::clock::now();
+  auto at  = now + request_timeout_;
+  for (auto& e : c->in_flight_)
+    at = std::min({at, e.sent_ + request_timeout_, e.deadline_});
+
+  // rounded up, so the request is past its time when abort looks at it.
+  auto d = std::chrono::duration_cast<std::chrono::milliseconds>(at - now);
+  c->timeout_.cancel();
+  c->timeout_.expires_from_now(
+      boost::posix_time::milliseconds(std::max<int64_t>(d.count(), 0) + 1));
+  c->timeout_.async_wait([c](boost::system::error_code ec) {
+    if (!ec && (c->is_writing_ || !c->in_flight_.empty()))
+    {
+      c->timed_out_ = true;
+      c->stream_->next_layer().cancel();
+    }
   });
 }
 
@@ -367,40 +1150,136 @@ void stream::async_connect()
 {
   reset();
 
-  std::string host = base_url_.host();
-  std::string port = base_url_.port().to_string();
-  if (port.empty())
-    port = "443";
-
   ctx_.set_verify_mode(boost::asio::ssl::verify_none);
 
-  if (!::SSL_set_tlsext_host_name(stream_->native_handle(), host.c_str()))
+  for (size_t i = 0; i < size(); i++)
+    connect(conns_[i].get());
+  ping_timer();
+}
+
+// connect opens c: TCP connect and TLS handshake, both asynchronous.
+void stream::connect(__connection* c)
+{
+  // the requests left in flight by close() are sent on the next connection.
+  fail(c);
+  close(c);
+  c->is_connecting_ = true;
+  if (resolve_results_.empty())
   {
-    boost::beast::error_code ec{static_cast<int>(::ERR_get_error()),
-                                boost::asio::error::get_ssl_category()};
-    throw binance::error{ec};
+    resolving_.emplace_back(c, c->gen_);
+    resolve();
+    return;
   }
 
-  if (resolve_results_.empty())
+  c->stream_.emplace(ioc_, ctx_);
+  c->buffer_.clear();
+  c->responses_ = 0;
+
+  std::string host = base_url_.host();
+  if (!::SSL_set_tlsext_host_name(c->stream_->native_handle(), host.c_str()))
   {
-    boost::asio::ip::tcp::resolver resolver(ioc_);
-    resolve_results_ = resolver.resolve(host, port);
+    boost::beast::error_code ec{static_cast<int>(::ERR_get_error()),
+                                boost::asio::error::get_ssl_category()};
+    report(ec);
+    reconnect(c);
+    return;
   }
 
   using std::placeholders::_1;
   using std::placeholders::_2;
 
-  boost::asio::async_connect(boost::beast::get_lowest_layer(*stream_),
-                             resolve_results_,
-                             std::bind(&stream::on_connect, this, _1, _2));
+  // connect and handshake get request_timeout_ together.
+  c->timeout_.expires_from_now(boost::posix_time::milliseconds(
+      std::chrono::duration_cast<std::chrono::milliseconds>(request_timeout_)
+          .count()));
+  c->timeout_.async_wait(
+      [c, gen = c->gen_](boost::system::error_code ec) {
+        if (ec || gen != c->gen_ || !c->is_connecting_)
+          return;
+        binance::boost_error ignored;
+        c->timed_out_ = true;
+        c->stream_->next_layer().close(ignored);
+      });
+
+  boost::asio::async_connect(
+      boost::beast::get_lowest_layer(*c->stream_), resolve_results_,
+      std::bind(&stream::on_connect, this, c, c->gen_, _1, _2));
 }
 
-void stream::renew_listen_key()
+// connect_failed reports why c could not be opened and opens it again after
+// the backoff. The host is looked up again, its address may have changed.
+void stream::connect_failed(__connection* c,
+                            boost::system::error_code const& ec)
+{
+  if (c->timed_out_)
+    report(__error_of(boost::asio::error::timed_out));
+  else
+    report(ec);
+  resolve_results_ = {};
+  reconnect(c);
+}
+
+void stream::resolve()
+{
+  if (resolving_.size() > 1)
+    return;  // a lookup since the last close() is on its way
+
+  std::string host = base_url_.host();
+  std::string port = base_url_.port().to_string();
+  if (port.empty())
+    port = "443";
+
+  resolver_.async_resolve(
+      host, port,
+      [this, gen = resolve_gen_](
+          boost::system::error_code ec,
+          boost::asio::ip::tcp::resolver::results_type results) {
+        if (gen != resolve_gen_ || ec == boost::asio::error::operation_aborted)
+          return;  // closed, the waiters are the next lookup's
+        auto waiting = std::move(resolving_);
+        resolving_.clear();
+        if (ec)
+          report(ec);
+        else
+          resolve_results_ = results;
+        for (auto [c, c_gen] : waiting)
+        {
+          if (c_gen != c->gen_)
+            continue;  // closed meanwhile
+          if (ec)
+            reconnect(c);
+          else
+            connect(c);
+        }
+      });
+}
+
+void stream::replace(__connection* c)
+{
+  if (!standby_ || conns_.size() <= pool_size_
+      || !conns_[pool_size_]->is_idle())
+  {
+    connect(c);
+    return;
+  }
+  for (size_t i = 0; i < pool_size_; i++)
+  {
+    if (conns_[i].get() == c)
+    {
+      std::swap(conns_[i], conns_[pool_size_]);
+      break;
+    }
+  }
+  connect(c);  // the standby now
+  next_async_request();
+}
+
+void stream::renew_listen_key(boost::posix_time::time_duration after)
 {
   timers_.emplace_back(ioc_);
 
   auto& timer = timers_.back();
-  timer.expires_from_now(boost::posix_time::minutes(59));
+  timer.expires_from_now(after);
   timer.async_wait([this](boost::system::error_code ec) {
     if (ec)
       return;
@@ -412,13 +1291,21 @@ void stream::renew_listen_key()
       delete e;
       renew_listen_key();
     };
+    // a failed renewal is reported and the chain goes on.
+    ErrorHandler on_error = [this, e](const binance::error& err) {
+      delete e;
+      report(err);
+      renew_listen_key(boost::posix_time::minutes(1));
+    };
 
     async_put<http::empty_body, __SECURITY_CODES::USER_DATA>(
-        "/fapi/v1/listenKey", e, std::move(f));
+        "/fapi/v1/listenKey", e, std::move(f), std::move(on_error));
     clear_timers();
   });
 }
 
+// ping_timer checks the health of every connection: idle ones are pinged to
+// keep them alive and closed ones are connected again.
 void stream::ping_timer()
 {
   timers_.emplace_back(ioc_);
@@ -431,332 +1318,859 @@ void stream::ping_timer()
 
     clear_timers();
 
-    if (is_writing_)
-      ping_timer();
-    else
-      async_ping();
+    for (size_t i = 0; i < size() && i < conns_.size(); i++)
+    {
+      __connection* c = conns_[i].get();
+      if (c->is_idle())
+        async_ping(c);
+      else if (!c->is_open() && !c->is_connecting_)
+        connect(c);
+    }
+    ping_timer();
   });
 }
 
-void stream::rate_timer()
+void stream::on_connect(__connection* c, size_t gen,
+                        boost::system::error_code const& ec,
+                        const boost::asio::ip::tcp::endpoint& endpoint)
 {
-  timers_.emplace_back(ioc_);
-
-  auto& timer = timers_.back();
-  timer.expires_from_now(boost::posix_time::seconds(limit_window_));
-  timer.async_wait([this](boost::system::error_code ec) {
-    if (ec)
-      return;
-
-    clear_timers();
+  boost::ignore_unused(endpoint);
+  if (gen != c->gen_)
+    return;
+  if (ec)
+  {
+    connect_failed(c, ec);
+    return;
+  }
 
-    if (rate_limit_ > 0)
-      rate_timer();
-    req_count_ = 0;
-    next_async_request();
-  });
+  c->stream_->async_handshake(
+      boost::asio::ssl::stream_base::client,
+      boost::beast::bind_front_handler(&stream::on_handshake, this, c, gen));
 }
 
-void stream::on_connect(boost::system::error_code const& ec,
-                        const boost::asio::ip::tcp::endpoint& endpoint)
+void stream::on_handshake(__connection* c, size_t gen,
+                          boost::system::error_code const& ec)
 {
+  if (gen != c->gen_)
+    return;
   if (ec)
-    throw ec;
-  is_writing_ = false;
-
-  stream_->handshake(boost::asio::ssl::stream_base::client);
+  {
+    connect_failed(c, ec);
+    return;
+  }
 
-  is_open_ = true;
-  stream_->next_layer().non_blocking(true);
+  c->timeout_.cancel();
+  c->is_connecting_ = false;
+  c->is_writing_    = false;
+  c->failures_      = 0;
+  c->is_open_       = true;
+  c->stream_->next_layer().non_blocking(true);
 
   next_async_request();
-  ping_timer();
+  // the first samples of the clock, if nothing else needs c.
+  if (time_sync_ && clock_.size() < 4 && c->is_idle())
+    async_ping(c);
 }
 
-void stream::on_write(boost::system::error_code const& ec, size_t size)
+void stream::on_write(__connection* c, size_t gen,
+                      boost::system::error_code const& ec, size_t size)
 {
   namespace http = boost::beast::http;
   boost::ignore_unused(size);
+  if (gen != c->gen_)
+    return;
   if (ec)
   {
-    disable_writing();
-    throw ec;
+    if (c->is_reading_ && __is_disconnect(ec))
+    {
+      // stop writing, the read left gets the responses already sent and
+      // handles the close.
+      c->is_writing_ = false;
+      c->is_open_    = false;
+      return;
+    }
+    abort(c, ec);
+    return;
   }
 
-  response_.clear();
-  response_.body().clear();
-  http::async_read(*stream_, buffer_, response_,
-                   boost::beast::bind_front_handler(&stream::on_read, this));
+  c->is_writing_ = false;
+  if (!c->is_reading_)
+    read(c);
+  next_async_request();
+}
+
+really_inline void stream::read(__connection* c)
+{
+  c->is_reading_ = true;
+  c->body_.clear();
+  c->parser_.emplace(c->body_, limiter_, c->in_flight_.front().sent_);
+  arm_hedge(c);
+  boost::beast::http::async_read_header(
+      *c->stream_, c->buffer_, *c->parser_,
+      boost::beast::bind_front_handler(&stream::on_read_header, this, c,
+                                       c->gen_));
 }
 
-// if an exception happens here the programmer should call discard_next
-// in case the request can be skipped and not re-tried.
-void stream::on_read(boost::system::error_code const& ec, size_t size)
+// on_read_header reads a body of known length straight into body_, past
+// the part read with the header. Chunked bodies and bodies that end with the
+// connection go through the parser.
+void stream::on_read_header(__connection* c, size_t gen,
+                            boost::system::error_code const& ec, size_t size)
+{
+  if (gen != c->gen_)
+    return;
+  auto& p = *c->parser_;
+  if (ec || p.is_done())
+  {
+    on_read(c, gen, ec, size);
+    return;
+  }
+  if (p.chunked() || !p.content_length())
+  {
+    boost::beast::http::async_read(
+        *c->stream_, c->buffer_, p,
+        boost::beast::bind_front_handler(&stream::on_read, this, c, gen));
+    return;
+  }
+
+  size_t n    = size_t(*p.content_length());
+  size_t have = std::min(n, c->buffer_.size());
+  if (have > 0)
+  {
+    auto b = c->body_.prepare(have);
+    std::memcpy(b.data(), c->buffer_.data().data(), have);
+    c->body_.commit(have);
+    c->buffer_.consume(have);
+  }
+  if (have == n)
+  {
+    on_read(c, gen, ec, size);
+    return;
+  }
+  boost::asio::async_read(
+      *c->stream_, c->body_.prepare(n - have),
+      boost::beast::bind_front_handler(&stream::on_read_body, this, c, gen));
+}
+
+void stream::on_read_body(__connection* c, size_t gen,
+                          boost::system::error_code const& ec, size_t size)
+{
+  if (gen != c->gen_)
+    return;
+  c->body_.commit(size);
+  on_read(c, gen, ec, size);
+}
+
+// on_read ends the request at the front of c: its handler gets the message,
+// or its error handler the error. A 429 or 418 sends it again after the
+// Retry-After, a 5xx after the retry delay if it is a GET.
+void stream::on_read(__connection* c, size_t gen,
+                     boost::system::error_code const& ec, size_t size)
 {
   boost::ignore_unused(size);
   namespace http = boost::beast::http;
 
+  if (gen != c->gen_)
+    return;
   if (ec)
   {
-    disable_writing();
-    throw ec;
+    abort(c, ec);
+    return;
   }
 
-  auto& res = response_;
-  if (res.result_int() != 200)
+  c->responses_++;
+  auto& p       = *c->parser_;
+  auto& body    = c->body_;
+  unsigned code = p.status();
+  auto it       = c->in_flight_.begin();
+  if (it->hedge_ && it->hedge_->done)
+    settle(c->in_flight_, it);  // the copy was answered first
+  else if (settle_failed(c->in_flight_, it, code))
+    ;
+  else if (it->cancelled_)
+    complete(c->in_flight_, it,
+             __error_of(boost::asio::error::operation_aborted));
+  else if (code == 429 || code == 418)
+    requeue(c->in_flight_, it);
+  else if (code >= 500 && can_retry(*it))
+    retry(c->in_flight_, it);
+  else if (code != 200)
+    complete(c->in_flight_, it, response_error(code, body));
+  else
   {
-    disable_writing();
-    throw binance::error{res.result_int(), res.body()};
+    binance::error err;
+    try
+    {
+      const json::value& v = parser_.parse(body).root();
+      if (v.is_object())
+        get_error_codes(err, v);
+      if (!err)
+        err = it->decode(v);
+    }
+    catch (const simdjson::simdjson_error& ex)
+    {
+      err = binance::error(binance::error::kind::decode, int(ex.error()),
+                           ex.what());
+    }
+
+    if (err)
+      complete(c->in_flight_, it, err);
+    else
+    {
+      if (it->lane_ == priority::market_data)
+        latencies_.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            rate_limiter::clock::now() - it->sent_));
+      if (it->hedge_)
+        it->hedge_->done = true;
+      (*it)();
+      recycle(std::move(it->wire_));
+      c->in_flight_.erase(it);
+    }
   }
 
-  auto& e = queue_.front();
+  // the handlers may have closed the stream.
+  if (gen != c->gen_)
+    return;
+  on_response(c, p.keep_alive());
+}
 
-  binance::error err;
-  const json::value& v = parser_.parse(res.body()).root();
+void stream::on_response(__connection* c, bool keep_alive)
+{
+  if (!keep_alive || (!c->is_open_ && c->in_flight_.empty()))
+  {
+    // the requests pipelined after this one won't be answered.
+    fail(c);
+    replace(c);
+    return;
+  }
 
-  if (v.is_object())
+  if (!c->in_flight_.empty())
   {
-    get_error_codes(err, v);
-    if (err)
+    arm_timeout(c);
+    read(c);
+  }
+  else
+  {
+    c->is_reading_ = false;
+    if (!c->is_writing_)
+      c->timeout_.cancel();
+  }
+  next_async_request();
+}
+
+void stream::fail(__connection* c)
+{
+  disable_writing(c);
+  // last first, so they keep their order at the front of their lanes.
+  while (!c->in_flight_.empty())
+  {
+    auto it = std::prev(c->in_flight_.end());
+    if (!settle(c->in_flight_, it))
+      requeue(c->in_flight_, it);
+  }
+}
+
+// settle drops it if it is a hedged copy whose answer is not needed: the
+// other copy was answered or is still in flight.
+bool stream::settle(std::list<__request_elem>& from,
+                    std::list<__request_elem>::iterator it)
+{
+  if (!it->hedge_ || (!it->hedge_->done && it->hedge_->pending < 2))
+    return false;
+  it->hedge_->pending--;
+  recycle(std::move(it->wire_));
+  from.erase(it);
+  return true;
+}
+
+// settle_failed settles it unless the response with status code is a
+// success, which is always taken.
+bool stream::settle_failed(std::list<__request_elem>& from,
+                           std::list<__request_elem>::iterator it,
+                           unsigned code)
+{
+  return code != 200 && settle(from, it);
+}
+
+void stream::requeue(std::list<__request_elem>& from,
+                     std::list<__request_elem>::iterator it)
+{
+  failed_lane_ = it->lane_;
+  auto& q      = queues_[size_t(it->lane_)];
+  q.splice(q.begin(), from, it);
+}
+
+// abort sends the GETs in flight again, as soon as the connection is back if
+// the server closed it after answering others (a keep-alive that expired) or
+// if timeout_ cut them off before their time, after the retry delay
+// otherwise. The rest complete with ec, or timed_out if timeout_ fired.
+void stream::abort(__connection* c, boost::system::error_code const& ec)
+{
+  bool stale     = __is_disconnect(ec) && c->responses_ > 0;
+  bool timed_out = c->timed_out_;
+  close(c);
+
+  auto now = rate_limiter::clock::now();
+  std::list<__request_elem> again;
+  while (!c->in_flight_.empty())
+  {
+    auto it = c->in_flight_.begin();
+    if (settle(c->in_flight_, it))
+      continue;
+    bool expired = it->sent_ + request_timeout_ <= now;
+    if (it->cancelled_)
+      complete(c->in_flight_, it,
+               __error_of(boost::asio::error::operation_aborted));
+    else if (it->deadline_ <= now)
+      complete(c->in_flight_, it, __error_of(boost::asio::error::timed_out));
+    else if (it->is_idempotent() && (stale || (timed_out && !expired)))
+      again.splice(again.end(), c->in_flight_, it);
+    else if (can_retry(*it))
     {
-      disable_writing();
-      throw err;
+      it->attempts_++;
+      it->not_before_ = now + retry_.delay(it->attempts_);
+      again.splice(again.end(), c->in_flight_, it);
     }
+    else if (timed_out)
+      complete(c->in_flight_, it, __error_of(boost::asio::error::timed_out));
+    else
+      complete(c->in_flight_, it, ec);
   }
+  // last first, so they keep their order at the front of their lanes.
+  while (!again.empty())
+    requeue(again, std::prev(again.end()));
 
-  e(v);
+  replace(c);
+}
 
-  queue_.pop_front();
-  disable_writing();
+void stream::reconnect(__connection* c)
+{
+  close(c);
+  c->is_connecting_ = true;
+  c->failures_++;
+  auto d = retry_.delay(c->failures_);
+  c->timeout_.expires_from_now(boost::posix_time::milliseconds(d.count()));
+  c->timeout_.async_wait(
+      [this, c, gen = c->gen_](boost::system::error_code ec) {
+        if (!ec && gen == c->gen_)
+          connect(c);
+      });
+}
+
+void stream::retry(std::list<__request_elem>& from,
+                   std::list<__request_elem>::iterator it)
+{
+  it->attempts_++;
+  it->not_before_ = rate_limiter::clock::now() + retry_.delay(it->attempts_);
+  requeue(from, it);
+}
+
+bool stream::can_retry(const __request_elem& e) const
+{
+  return e.is_idempotent() && e.attempts_ + 1 < retry_.max_attempts;
+}
+
+void stream::complete(std::list<__request_elem>& from,
+                      std::list<__request_elem>::iterator it,
+                      const binance::error& err)
+{
+  ErrorHandler on_error = std::move(it->on_error_);
+  if (it->hedge_)
+    it->hedge_->done = true;  // the copy left is dropped
+  recycle(std::move(it->wire_));
+  from.erase(it);
+  if (on_error)
+    on_error(err);
+  else
+    report(err);
+}
+
+void stream::report(const binance::error& err)
+{
+#ifdef BINANCE_DEBUG
+  std::cout << "ERR: " << err << std::endl;
+#endif
+  if (on_error_)
+    on_error_(err);
+}
 
-  auto it = res.base().find("Connection");
-  if (it != res.base().end() && it->value() == "close")
+binance::error stream::response_error(unsigned code, const padded_buffer& body)
+{
+  std::string_view s(static_cast<const char*>(body.data().data()),
+                     body.size());
+  binance::error err(code, s);
+  try
   {
-    async_connect();  // reconnect
+    const json::value& v = parser_.parse(body).root();
+    if (v.is_object())
+      get_error_codes(err, v);
   }
-  else
+  catch (const simdjson::simdjson_error&)
+  {
+  }
+  return err;
+}
+
+__connection* stream::ready_connection(const __request_elem& e)
+{
+  __connection* idle = nullptr;
+  __connection* best = nullptr;
+  size_t n_idle      = 0;
+  for (size_t i = 0; i < pool_size_ && i < conns_.size(); i++)
   {
-    next_async_request();
+    __connection* c = conns_[i].get();
+    if (c->is_idle())
+    {
+      if (idle == nullptr)
+        idle = c;
+      n_idle++;
+      continue;
+    }
+
+    // pipeline behind idempotent requests only, never behind an order.
+    if (pipeline_depth_ > 1 && c->is_open() && !c->is_writing_
+        && c->in_flight_.size() < pipeline_depth_ && e.is_idempotent()
+        && c->in_flight_.back().is_idempotent()
+        && (best == nullptr || c->in_flight_.size() < best->in_flight_.size()))
+      best = c;
   }
+
+  // the last idle connection is kept for orders.
+  bool reserve = pool_size_ > 1 && e.lane_ != priority::order_entry;
+  if (idle != nullptr && (!reserve || n_idle > 1))
+    return idle;
+  return best;
 }
 
 really_inline void stream::next_async_request()
 {
-  if (not is_open() || queue_.empty() || is_writing_
-      || (rate_limit_ > 0 && req_count_ >= rate_limit_))
+  for (;;)
+  {
+    // lanes by priority, a starving one first.
+    std::array<size_t, priority_count + 1> order;
+    size_t n = 0;
+    for (size_t l = 1; l < priority_count; l++)
+    {
+      if (!queues_[l].empty() && skipped_[l] >= starvation_limit_)
+      {
+        order[n++] = l;
+        break;
+      }
+    }
+    for (size_t l = 0; l < priority_count; l++)
+      order[n++] = l;
+
+    // a request held by the weight budget keeps the lanes after it from
+    // spending that budget. Orders that weigh nothing still go.
+    auto now        = rate_limiter::clock::now();
+    auto wait       = rate_limiter::duration::max();
+    bool held       = false;
+    __connection* c = nullptr;
+    size_t lane     = 0;
+    for (size_t i = 0; i < n && c == nullptr; i++)
+    {
+      lane = order[i];
+      if (queues_[lane].empty())
+        continue;
+      auto& e = queues_[lane].front();
+      if (e.deadline_ <= now)
+      {
+        complete(queues_[lane], queues_[lane].begin(),
+                 __error_of(boost::asio::error::timed_out));
+        i--;  // the next one in this lane
+        continue;
+      }
+      if (e.not_before_ > now)
+      {
+        wait = std::min(wait, e.not_before_ - now);
+        continue;
+      }
+      if (held && e.cost_.weight > 0)
+        continue;
+      auto d = limiter_.wait(e.cost_, now);
+      if (d != rate_limiter::duration::zero())
+      {
+        held = held || e.cost_.weight > 0;
+        wait = std::min(wait, d);
+        continue;
+      }
+      c = ready_connection(e);
+    }
+    if (c == nullptr)
+    {
+      if (wait != rate_limiter::duration::max())
+        arm_limit_timer(wait);
+      return;
+    }
+
+    for (size_t l = 0; l < priority_count; l++)
+      skipped_[l] = l == lane ? 0 : skipped_[l] + !queues_[l].empty();
+
+    auto& q = queues_[lane];
+    auto& e = q.front();
+    limiter_.try_acquire(e.cost_, now);
+    e.sent_ = now;
+    // stamped and signed now, not when queued: the wait in the lanes, the
+    // limiter or the retry backoff doesn't count against the recvWindow.
+    if (e.sign_ != nullptr)
+      (this->*e.sign_)(e);
+    c->in_flight_.splice(c->in_flight_.end(), q, q.begin());
+    write(c);
+  }
+}
+
+// arm_limit_timer calls next_async_request again in d.
+void stream::arm_limit_timer(rate_limiter::duration d)
+{
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+  limit_timer_.expires_from_now(boost::posix_time::milliseconds(ms + 1));
+  limit_timer_.async_wait([this](boost::system::error_code ec) {
+    if (!ec)
+      next_async_request();
+  });
+}
+
+// arm_hedge hedges the request at the front of c if it is still waiting
+// after the hedge delay.
+void stream::arm_hedge(__connection* c)
+{
+  auto& e = c->in_flight_.front();
+  // pings and time samples have no id.
+  if (!hedge_.enabled || e.hedge_ || e.id_ == 0
+      || e.lane_ != priority::market_data || !e.is_idempotent())
     return;
 
-  auto& e = queue_.front();
-  boost::variant2::visit([this](auto req) { do_write(*req); }, e.req_);
+  auto at = e.sent_ + latencies_.hedge_delay(hedge_);
+  auto d  = std::chrono::duration_cast<std::chrono::microseconds>(
+      at - rate_limiter::clock::now());
+  c->hedge_timer_.expires_from_now(
+      boost::posix_time::microseconds(std::max<int64_t>(d.count(), 0)));
+  c->hedge_timer_.async_wait(
+      [this, c, gen = c->gen_, id = e.id_](boost::system::error_code ec) {
+        if (!ec && gen == c->gen_ && !c->in_flight_.empty()
+            && c->in_flight_.front().id_ == id)
+          hedge(c);
+      });
 }
 
-template<class T>
-really_inline void stream::do_write(boost::beast::http::request<T>& req)
+// hedge writes a copy of the request at the front of c to another idle
+// connection, keeping one for orders.
+void stream::hedge(__connection* c)
 {
-  enable_writing();
-  boost::beast::http::async_write(
-      *stream_, req, boost::beast::bind_front_handler(&stream::on_write, this));
+  __connection* to = nullptr;
+  size_t n_idle    = 0;
+  for (size_t i = 0; i < pool_size_ && i < conns_.size(); i++)
+  {
+    if (conns_[i].get() != c && conns_[i]->is_idle())
+    {
+      if (to == nullptr)
+        to = conns_[i].get();
+      n_idle++;
+    }
+  }
+  if (to == nullptr || (pool_size_ > 1 && n_idle < 2))
+    return;
+
+  auto& e  = c->in_flight_.front();
+  auto now = rate_limiter::clock::now();
+  if (e.hedge_ || !limiter_.try_acquire(e.cost_, now))
+    return;
+
+  e.hedge_          = std::make_shared<__hedge>();
+  e.hedge_->pending = 2;
+  to->in_flight_.push_back(e);
+  to->in_flight_.back().sent_ = now;
+  write(to);
 }
 
-template<class ReqBody, class Msg, __SECURITY_CODES C>
-void stream::async_call(
-    std::shared_ptr<boost::beast::http::request<ReqBody>> req, Msg* msg,
-    DefaultHandler<Msg> cb)
+really_inline void stream::write(__connection* c)
 {
-  namespace http = boost::beast::http;
+  auto& e = c->in_flight_.back();
 #ifdef BINANCE_DEBUG
-  std::cout << "REQ: " << req->base().target();
-  if constexpr (!std::is_same_v<ReqBody, http::empty_body>)
-    std::cout << "\n" << req->body() << std::endl;
-  std::cout << std::endl;
+  std::cout << "REQ: " << e.wire_ << std::endl;
 #endif
-  prepare_request<ReqBody, Msg, C>(*req, msg);
-  if constexpr (!std::is_same_v<ReqBody, http::empty_body>)
-    req->set(http::field::content_length, std::to_string(req->body().size()));
+  enable_writing(c);
+  boost::asio::async_write(
+      *c->stream_, boost::asio::buffer(e.wire_),
+      boost::beast::bind_front_handler(&stream::on_write, this, c, c->gen_));
+}
 
-  queue_.emplace_back(req, msg, std::move(cb));
+template<class ReqBody, class Msg, __SECURITY_CODES C>
+request_handle stream::async_call(boost::beast::http::verb method,
+                                  std::string_view endpoint, Msg* msg,
+                                  DefaultHandler<Msg> cb,
+                                  ErrorHandler on_error)
+{
+  constexpr bool is_signed =
+      C == __SECURITY_CODES::USER_DATA || C == __SECURITY_CODES::TRADE;
+
+  auto cost     = cost_of(method, endpoint, *msg);
+  const auto& t = request_template<ReqBody, C>(method, endpoint);
+  std::string wire;
+  if constexpr (!is_signed)
+    wire = build_request<Msg, C>(t, msg);
+
+  constexpr priority lane = __priority_of<C>();
+  queues_[size_t(lane)].emplace_back(std::move(wire), method, msg,
+                                     std::move(cb), std::move(on_error), lane);
+  auto& e = queues_[size_t(lane)].back();
+  e.cost_ = cost;
+  e.id_   = next_id_++;
+  if constexpr (is_signed)
+  {
+    e.template_ = &t;
+    e.sign_     = &stream::sign<Msg, C>;
+  }
+  request_handle h(this, e.id_);
 
   next_async_request();
+  return h;
 }
 
 template<class ReqBody, __SECURITY_CODES C, class Msg>
-void stream::async_get(const std::string& endpoint, Msg* msg,
-                       DefaultHandler<Msg> cb)
+request_handle stream::async_get(std::string_view endpoint, Msg* msg,
+                                 DefaultHandler<Msg> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  // TODO: Remove the pointer from here
-  auto req =
-      std::make_shared<http::request<ReqBody>>(http::verb::get, endpoint, 11);
-
-  async_call<ReqBody, Msg, C>(req, msg, cb);
+  return async_call<ReqBody, Msg, C>(http::verb::get, endpoint, msg,
+                                     std::move(cb), std::move(on_error));
 }
 
 template<class ReqBody, __SECURITY_CODES C, class Msg>
-void stream::async_put(const std::string& endpoint, Msg* msg,
-                       DefaultHandler<Msg> cb)
+request_handle stream::async_put(std::string_view endpoint, Msg* msg,
+                                 DefaultHandler<Msg> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  auto req =
-      std::make_shared<http::request<ReqBody>>(http::verb::put, endpoint, 11);
-
-  async_call<ReqBody, Msg, C>(req, msg, cb);
+  return async_call<ReqBody, Msg, C>(http::verb::put, endpoint, msg,
+                                     std::move(cb), std::move(on_error));
 }
 
 template<class ReqBody, __SECURITY_CODES C, class Msg>
-void stream::async_del(const std::string& endpoint, Msg* msg,
-                       DefaultHandler<Msg> cb)
+request_handle stream::async_del(std::string_view endpoint, Msg* msg,
+                                 DefaultHandler<Msg> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  auto req       = std::make_shared<http::request<ReqBody>>(http::verb::delete_,
-                                                      endpoint, 11);
-
-  async_call<ReqBody, Msg, C>(req, msg, cb);
+  return async_call<ReqBody, Msg, C>(http::verb::delete_, endpoint, msg,
+                                     std::move(cb), std::move(on_error));
 }
 
 template<class ReqBody, __SECURITY_CODES C, class Msg>
-void stream::async_post(const std::string& endpoint, Msg* msg,
-                        DefaultHandler<Msg> cb)
+request_handle stream::async_post(std::string_view endpoint, Msg* msg,
+                                  DefaultHandler<Msg> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  auto req =
-      std::make_shared<http::request<ReqBody>>(http::verb::post, endpoint, 11);
-
-  async_call<ReqBody, Msg, C>(req, msg, cb);
+  return async_call<ReqBody, Msg, C>(http::verb::post, endpoint, msg,
+                                     std::move(cb), std::move(on_error));
 }
 
 template<typename T, class... Args>
-void stream::async_read(DefaultHandler<T> cb, Args... args)
+request_handle stream::async_read(DefaultHandler<T> cb, Args... args)
 {
   auto v = std::make_shared<T>(std::forward<Args>(args)...);
-  async_read(v.get(), [v, cb](T* p) { cb(p); });
+  return async_read(v.get(), [v, cb](T* p) { cb(p); });
 }
 
 template<typename T, class... Args>
-void stream::async_write(DefaultHandler<T> cb, Args... args)
+request_handle stream::async_write(DefaultHandler<T> cb, Args... args)
 {
   auto v = std::make_shared<T>(std::forward<Args>(args)...);
-  async_write(v.get(), [v, cb](T* p) { cb(p); });
+  return async_write(v.get(), [v, cb](T* p) { cb(p); });
 }
 
-void stream::async_read(messages::get_position_mode* msg,
-                        DefaultHandler<messages::get_position_mode> cb)
+request_handle stream::async_read(
+    messages::get_position_mode* msg,
+    DefaultHandler<messages::get_position_mode> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_get<http::empty_body, __SECURITY_CODES::USER_DATA>(
-      "/fapi/v1/positionSide/dual", msg, std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_get<http::empty_body, __SECURITY_CODES::USER_DATA>(
+      "/fapi/v1/positionSide/dual", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::kline_data* msg,
-                        DefaultHandler<messages::kline_data> cb)
+request_handle stream::async_read(messages::server_time* msg,
+                                  DefaultHandler<messages::server_time> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/klines", msg,
-                                                      std::move(cb));
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/time", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::listen_key* msg,
-                        DefaultHandler<messages::listen_key> cb)
+request_handle stream::async_read(messages::kline_data* msg,
+                                  DefaultHandler<messages::kline_data> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_post<http::empty_body, __SECURITY_CODES::USER_STREAM>(
-      "/fapi/v1/listenKey", msg, std::move(cb));
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/klines", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_write(messages::place_order* msg,
-                         DefaultHandler<messages::place_order> cb)
+request_handle stream::async_read(
+    messages::kline_series_data* msg,
+    DefaultHandler<messages::kline_series_data> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_post<http::string_body, __SECURITY_CODES::TRADE>("/fapi/v1/order", msg,
-                                                         std::move(cb));
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/klines", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_write(messages::cancel_order* msg,
-                         DefaultHandler<messages::cancel_order> cb)
+request_handle stream::async_read(messages::listen_key* msg,
+                                  DefaultHandler<messages::listen_key> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_del<http::string_body, __SECURITY_CODES::TRADE>("/fapi/v1/order", msg,
-                                                        std::move(cb));
+  return async_post<http::empty_body, __SECURITY_CODES::USER_STREAM>(
+      "/fapi/v1/listenKey", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_write(messages::cancel_order_all* msg,
-                         DefaultHandler<messages::cancel_order_all> cb)
+request_handle stream::async_write(messages::place_order* msg,
+                                   DefaultHandler<messages::place_order> cb,
+                                   ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_del<http::string_body, __SECURITY_CODES::TRADE>(
-      "/fapi/v1/allOpenOrders", msg, std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_post<http::string_body, __SECURITY_CODES::TRADE>(
+      "/fapi/v1/order", msg, std::move(cb), std::move(on_error));
+}
+
+order_template stream::make_order_template(const messages::place_order& shared)
+{
+  return order_template(signer_, shared, shared.price_precision(),
+                        shared.qty_precision());
 }
 
-void stream::async_read(messages::current_open_order* msg,
-                        DefaultHandler<messages::current_open_order> cb)
+request_handle stream::async_write(messages::cancel_order* msg,
+                                   DefaultHandler<messages::cancel_order> cb,
+                                   ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_get<http::empty_body, __SECURITY_CODES::USER_DATA>("/fapi/v1/openOrder",
-                                                           msg, std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_del<http::string_body, __SECURITY_CODES::TRADE>(
+      "/fapi/v1/order", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::current_open_order_all* msg,
-                        DefaultHandler<messages::current_open_order_all> cb)
+request_handle stream::async_write(
+    messages::cancel_order_all* msg,
+    DefaultHandler<messages::cancel_order_all> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  msg->insert_kv({"timestamp", string_milli_epoch()});
-  async_get<http::empty_body, __SECURITY_CODES::USER_DATA>("/fapi/v1/allOrders",
-                                                           msg, std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_del<http::string_body, __SECURITY_CODES::TRADE>(
+      "/fapi/v1/allOpenOrders", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::exchange_info* msg,
-                        DefaultHandler<messages::exchange_info> cb)
+request_handle stream::async_read(
+    messages::current_open_order* msg,
+    DefaultHandler<messages::current_open_order> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/exchangeInfo",
-                                                      msg, std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_get<http::empty_body, __SECURITY_CODES::USER_DATA>(
+      "/fapi/v1/openOrder", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::orderbook* msg,
-                        DefaultHandler<messages::orderbook> cb)
+request_handle stream::async_read(
+    messages::current_open_order_all* msg,
+    DefaultHandler<messages::current_open_order_all> cb, ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/depth", msg,
-                                                      std::move(cb));
+  msg->insert_kv({"timestamp", timestamp()});
+  return async_get<http::empty_body, __SECURITY_CODES::USER_DATA>(
+      "/fapi/v1/allOrders", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::recent_trades* msg,
-                        DefaultHandler<messages::recent_trades> cb)
+request_handle stream::async_read(messages::exchange_info* msg,
+                                  DefaultHandler<messages::exchange_info> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/klines", msg,
-                                                      std::move(cb));
+  DefaultHandler<messages::exchange_info> f =
+      [this, cb = std::move(cb)](messages::exchange_info* exi) {
+        if (!exi->rate_limits.empty())
+          set_rate_limits(exi->rate_limits);
+        cb(exi);
+      };
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/exchangeInfo", msg, std::move(f), std::move(on_error));
 }
 
-void stream::async_read(messages::mark_price* msg,
-                        DefaultHandler<messages::mark_price> cb)
+request_handle stream::async_read(messages::orderbook* msg,
+                                  DefaultHandler<messages::orderbook> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/premiumIndex",
-                                                      msg, std::move(cb));
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/depth", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_read(messages::price_ticker* msg,
-                        DefaultHandler<messages::price_ticker> cb)
+request_handle stream::async_read(messages::recent_trades* msg,
+                                  DefaultHandler<messages::recent_trades> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  async_get<http::empty_body, __SECURITY_CODES::NONE>("/fapi/v1/ticker/price",
-                                                      msg, std::move(cb));
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/klines", msg, std::move(cb), std::move(on_error));
 }
 
-void stream::async_ping()
+request_handle stream::async_read(messages::mark_price* msg,
+                                  DefaultHandler<messages::mark_price> cb,
+                                  ErrorHandler on_error)
 {
   namespace http = boost::beast::http;
-  auto v         = std::make_shared<messages::empty_args>();
-  async_get<http::empty_body, __SECURITY_CODES::NONE, messages::empty_args>(
-      "/fapi/v1/ping", v.get(), [this, v](auto* e) {
-        boost::ignore_unused(e);
-        ping_timer();
-      });
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/premiumIndex", msg, std::move(cb), std::move(on_error));
+}
+
+request_handle stream::async_read(messages::price_ticker* msg,
+                                  DefaultHandler<messages::price_ticker> cb,
+                                  ErrorHandler on_error)
+{
+  namespace http = boost::beast::http;
+  return async_get<http::empty_body, __SECURITY_CODES::NONE>(
+      "/fapi/v1/ticker/price", msg, std::move(cb), std::move(on_error));
+}
+
+// async_ping writes a ping to c directly, without going through the queue,
+// if the budget allows it. With time_sync_ the ping samples the exchange
+// clock.
+void stream::async_ping(__connection* c)
+{
+  auto now = rate_limiter::clock::now();
+  if (!limiter_.try_acquire(request_cost{}, now))
+    return;
+
+  if (time_sync_)
+  {
+    auto v = std::make_shared<messages::server_time>();
+    write_direct<messages::server_time>(
+        c, "/fapi/v1/time", v.get(),
+        [this, v, now](messages::server_time* t) {
+          clock_.add(now, rate_limiter::clock::now(), t->time);
+        },
+        now);
+    return;
+  }
+
+  auto v = std::make_shared<messages::empty_args>();
+  write_direct<messages::empty_args>(
+      c, "/fapi/v1/ping", v.get(),
+      [v](messages::empty_args* e) { boost::ignore_unused(e); }, now);
+}
+
+template<class Msg>
+void stream::write_direct(__connection* c, std::string_view endpoint, Msg* msg,
+                          DefaultHandler<Msg> cb, rate_limiter::time_point now)
+{
+  namespace http = boost::beast::http;
+  auto wire      = build_request<Msg, __SECURITY_CODES::NONE>(
+      request_template<http::empty_body, __SECURITY_CODES::NONE>(
+          http::verb::get, endpoint),
+      msg);
+
+  c->in_flight_.emplace_back(std::move(wire), http::verb::get, msg,
+                             std::move(cb));
+  c->in_flight_.back().sent_ = now;
+  write(c);
 }
 
 really_inline void stream::get_error_codes(binance::error& ec,
@@ -764,13 +2178,11 @@ really_inline void stream::get_error_codes(binance::error& ec,
 {
   int code = 0;
   json::value_to(jv, "code", code);
+  if (code == 0)
+    return;  // ec is kept, the HTTP status of a response_error
 
   ec = code;
-  if (ec)
-  {
-    json::value_to(jv, "msg", ec);
-    return;
-  }
+  json::value_to(jv, "msg", ec);
 }
 
 template<class JSONValue>
@@ -792,49 +2204,141 @@ really_inline void stream::parse_response(binance::error& ec, JSONValue& v,
   json::value_to(jb, "data", v);
 }
 
-template<class BodyType, class Msg, __SECURITY_CODES C>
-void stream::prepare_request(boost::beast::http::request<BodyType>& req,
-                             Msg* msg)
+template<class ReqBody, __SECURITY_CODES C>
+const __request_template& stream::request_template(
+    boost::beast::http::verb method, std::string_view endpoint)
 {
   namespace http = boost::beast::http;
+  constexpr bool has_body = !std::is_same_v<ReqBody, http::empty_body>;
 
-  req.set(http::field::host, base_url_.host());
-  req.set(http::field::user_agent, BINANCE_VERSION_STRING);
-  req.set(http::field::connection, "keep-alive");
-  if constexpr (std::is_same<BodyType, http::string_body>::value)
-    req.set(http::field::content_type, "application/x-www-form-urlencoded");
-
-  std::string target = req.target().to_string();
-  std::string query;
-
-  // if constexpr (std::is_base_of_v<query_args, Msg>)
-  if (!msg->args().empty())
+  for (auto& t : templates_)
   {
-    // TODO: Try to parse a copy of the base_url_
-    binance::http::parse_args(target, query, msg->args());
-  }
-
-  if constexpr (C == __SECURITY_CODES::USER_DATA
-                || C == __SECURITY_CODES::TRADE)
-  {
-    crypto::signer ss(auth_.secret);
-    ss.update(query);
-
-    query += "&signature=" + ss.final();
+    if (t.method_ == method && t.endpoint_ == endpoint && t.code_ == C
+        && t.has_body_ == has_body)
+      return t;
   }
 
+  std::string host = base_url_.host();
+  auto verb        = http::to_string(method);
+
+  __request_template t;
+  t.method_   = method;
+  t.endpoint_ = endpoint;
+  t.code_     = C;
+  t.has_body_ = has_body;
+  t.head_.assign(verb.data(), verb.size());
+  t.head_ += ' ';
+  t.head_ += endpoint;
+
+  t.fields_ = " HTTP/1.1\r\nHost: ";
+  t.fields_ += host;
+  t.fields_ += "\r\nUser-Agent: " BINANCE_VERSION_STRING
+               "\r\nConnection: keep-alive\r\n";
+  if constexpr (has_body)
+    t.fields_ += "Content-Type: application/x-www-form-urlencoded\r\n";
   if constexpr (C == __SECURITY_CODES::USER_DATA || C == __SECURITY_CODES::TRADE
                 || C == __SECURITY_CODES::USER_STREAM
                 || C == __SECURITY_CODES::MARKET_DATA)
-    req.set("X-MBX-APIKEY", auth_.key);
+    t.fields_ += "X-MBX-APIKEY: " + auth_.key + "\r\n";
+
+  templates_.push_back(std::move(t));
+  return templates_.back();
+}
 
-  if constexpr (std::is_same<BodyType, http::empty_body>::value)
-    req.target(target + "?" + query);
+template<class Msg, __SECURITY_CODES C>
+std::string stream::build_request(const __request_template& t, Msg* msg)
+{
+  path_.clear();
+
+  const order_template* from = nullptr;
+  if constexpr (std::is_same_v<Msg, messages::place_order>)
+    from = msg->from();
+
+  // query_ is not cleared for templates: the prefix written by the last order
+  // of the same template is kept.
+  if (from != nullptr)
+    from->write(query_, *msg);
+  else if constexpr (C == __SECURITY_CODES::USER_DATA
+                     || C == __SECURITY_CODES::TRADE)
+  {
+    query_.clear();
+    msg->append_to(path_, query_);
+    size_t n = query_.size();
+    query_ += "&signature=";
+    size_t m = query_.size();
+    query_.resize(m + crypto::signer::hex_size);
+    signer_.sign(std::string_view(query_.data(), n), &query_[m]);
+  }
   else
   {
-    req.target(target);
-    req.body() = query;
+    query_.clear();
+    msg->append_to(path_, query_);
+  }
+
+  std::string wire;
+  if (!spare_.empty())
+  {
+    wire = std::move(spare_.back());
+    spare_.pop_back();
+    wire.clear();
+  }
+
+  wire += t.head_;
+  wire += path_;
+  if (!t.has_body_ && !query_.empty())
+  {
+    wire += '?';
+    wire += query_;
+  }
+  wire += t.fields_;
+  if (t.has_body_)
+  {
+    char n[20];
+    auto res = std::to_chars(n, n + sizeof(n), query_.size());
+    wire += "Content-Length: ";
+    wire.append(n, res.ptr);
+    wire += "\r\n";
   }
+  wire += "\r\n";
+  if (t.has_body_)
+    wire += query_;
+  return wire;
+}
+
+template<class Msg, __SECURITY_CODES C>
+void stream::sign(__request_elem& e)
+{
+  auto* msg = static_cast<Msg*>(e.message_);
+  if (msg->contains("timestamp"))
+    msg->insert_kv({"timestamp", timestamp()});
+
+  std::string wire = build_request<Msg, C>(*e.template_, msg);
+  std::swap(e.wire_, wire);
+  if (!wire.empty())
+    recycle(std::move(wire));  // the one of the last attempt
+}
+
+really_inline void stream::recycle(std::string&& wire)
+{
+  if (spare_.size() < 64)
+    spare_.push_back(std::move(wire));
+}
+
+request_handle& request_handle::expires_after(rate_limiter::duration d)
+{
+  return expires_at(rate_limiter::clock::now() + d);
+}
+
+request_handle& request_handle::expires_at(rate_limiter::time_point t)
+{
+  if (s_ != nullptr)
+    s_->set_deadline(id_, t);
+  return *this;
+}
+
+bool request_handle::cancel()
+{
+  return s_ != nullptr && s_->cancel(id_);
 }
 }  // namespace http
 }  // namespace binance
@@ -1,59 +1,294 @@
 #ifndef BINANCE_JSON_HPP
 #define BINANCE_JSON_HPP
 
-#include <immintrin.h>
 #include <simdjson.h>
 
 #include <binance/common.hpp>
 #include <binance/conv.hpp>
 #include <binance/error.hpp>
+#include <binance/padded_buffer.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
+#include <algorithm>
 #include <chrono>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace binance
 {
 namespace json
 {
+// capacity_policy bounds the memory of a parser. It starts with initial bytes,
+// grows (to the next power of 2) for larger documents up to max, and goes back
+// to initial once shrink_after documents in a row fit in it again.
+struct capacity_policy
+{
+  size_t initial      = 128 * 1024;
+  size_t max          = 32 * 1024 * 1024;
+  size_t shrink_after = 1024;
+};
+
+struct parser_stats
+{
+  size_t documents = 0;
+  size_t largest   = 0;  // size of the largest document parsed
+  size_t grows     = 0;
+  size_t shrinks   = 0;
+};
+
 class parser
 {
   simdjson::dom::parser parser_;
   simdjson::dom::element root_;
+  capacity_policy policy_;
+  parser_stats stats_;
+  size_t small_streak_ = 0;
 
 public:
   parser(size_t alloc_mem = 128 * 1024)
+      : parser(capacity_policy{alloc_mem,
+                               std::max(alloc_mem, capacity_policy{}.max)})
   {
-    if (parser_.allocate(alloc_mem) != simdjson::error_code::SUCCESS)  // 128 KB
-      throw std::bad_alloc{};
   }
-  parser(parser&);
-  parser(parser&&);
+  parser(const capacity_policy& policy)
+      : parser_(policy.max)
+      , policy_(policy)
+  {
+    allocate(policy_.initial);
+  }
+  parser(const parser&) = delete;
+  parser& operator=(const parser&) = delete;
+  parser(parser&&)                 = default;
+  parser& operator=(parser&&) = default;
+
+  // parse parses buffer in place: SIMDJSON_PADDING readable bytes must follow
+  // it.
   inline parser& parse(const char* buffer, size_t buffer_size)
   {
-    root_ = parser_.parse(buffer, buffer_size, false);
-    return *this;
+    return parse(buffer, buffer_size, false);
   }
 
+  // strings are parsed in place when their capacity leaves room for the
+  // padding, copied otherwise.
   inline parser& parse(const std::string& buffer)
   {
-    parse((const char*) &buffer[0], buffer.size());
-    return *this;
+    bool padded =
+        buffer.capacity() - buffer.size() >= simdjson::SIMDJSON_PADDING;
+    return parse(buffer.data(), buffer.size(), !padded);
   }
 
+  inline parser& parse(const padded_buffer& buffer)
+  {
+    return parse(static_cast<const char*>(buffer.data().data()), buffer.size(),
+                 false);
+  }
+
+  // flat_buffer doesn't guarantee any padding, so it is copied. Read into a
+  // padded_buffer (binance::buffer) to parse in place.
   inline parser& parse(const boost::beast::flat_buffer& buffer)
   {
-    const char* body = (const char*) buffer.data().data();
-    parse(body, buffer.size());
-    return *this;
+    return parse(static_cast<const char*>(buffer.data().data()), buffer.size(),
+                 true);
   }
 
   really_inline simdjson::dom::element& root()
   {
     return root_;
   }
+
+  size_t capacity() const
+  {
+    return parser_.capacity();
+  }
+
+  const capacity_policy& policy() const
+  {
+    return policy_;
+  }
+
+  const parser_stats& stats() const
+  {
+    return stats_;
+  }
+
+  // reset goes back to the initial capacity. The stats are kept.
+  void reset()
+  {
+    if (parser_.capacity() != policy_.initial)
+      allocate(policy_.initial);
+    small_streak_ = 0;
+  }
+
+  // parse_many decodes a buffer of newline-delimited documents (e.g. recorded
+  // frames), calling f with the root of every document. batch_size must be
+  // larger than the biggest document, and is capped to policy().max. Returns
+  // the number of documents.
+  //
+  // With BINANCE_JSON_THREADS, simdjson indexes the next batch in a worker
+  // thread while the current one is being decoded.
+  template<class F>
+  size_t parse_many(const simdjson::padded_string& buffer, F&& f,
+                    size_t batch_size = simdjson::dom::DEFAULT_BATCH_SIZE)
+  {
+    batch_size = fit_batch(batch_size);
+    return for_each_document(parser_.parse_many(buffer, batch_size), f);
+  }
+
+  // load_many is parse_many for a file.
+  template<class F>
+  size_t load_many(const std::string& path, F&& f,
+                   size_t batch_size = simdjson::dom::DEFAULT_BATCH_SIZE)
+  {
+    batch_size = fit_batch(batch_size);
+    return for_each_document(parser_.load_many(path, batch_size), f);
+  }
+
+private:
+  inline parser& parse(const char* buffer, size_t buffer_size, bool copy)
+  {
+    reserve(buffer_size);
+    root_ = parser_.parse(buffer, buffer_size, copy);
+    return *this;
+  }
+
+  void allocate(size_t capacity)
+  {
+    if (parser_.allocate(capacity) != simdjson::error_code::SUCCESS)
+      throw std::bad_alloc{};
+  }
+
+  // reserve applies the capacity policy before parsing a document of size
+  // bytes. Documents larger than policy().max are left to simdjson, which
+  // fails with CAPACITY.
+  void reserve(size_t size)
+  {
+    stats_.documents++;
+    stats_.largest = std::max(stats_.largest, size);
+    fit(size);
+  }
+
+  void fit(size_t size)
+  {
+    size_t capacity = parser_.capacity();
+    if (size > capacity && size <= policy_.max)
+    {
+      size_t n = std::max(capacity * 2, size_t(1));
+      while (n < size)
+        n *= 2;
+      allocate(std::min(n, policy_.max));
+      stats_.grows++;
+      small_streak_ = 0;
+    }
+    else if (capacity > policy_.initial)
+    {
+      small_streak_ = size <= policy_.initial ? small_streak_ + 1 : 0;
+      if (small_streak_ >= policy_.shrink_after)
+      {
+        allocate(policy_.initial);
+        stats_.shrinks++;
+        small_streak_ = 0;
+      }
+    }
+  }
+
+  // fit_batch grows the parser for a batch of parse_many, so simdjson
+  // doesn't allocate past the policy on its own.
+  size_t fit_batch(size_t batch_size)
+  {
+    batch_size = std::min(batch_size, policy_.max);
+    fit(batch_size);
+    return batch_size;
+  }
+
+  template<class F>
+  size_t for_each_document(simdjson::dom::document_stream stream, F& f)
+  {
+    size_t n = 0;
+    for (auto it = stream.begin(); it != stream.end(); ++it)
+    {
+      simdjson::dom::element doc = *it;
+      stats_.largest             = std::max(stats_.largest, it.source().size());
+      f(doc);
+      ++n;
+    }
+    stats_.documents += n;
+    return n;
+  }
+};
+
+// parser_pool keeps the idle parsers of a thread, so connections opened and
+// closed over time reuse them instead of allocating new ones. At most max_idle
+// parsers are kept, all reset to the initial capacity. Their stats() are kept
+// too, so they cover every user of the parser.
+//
+//   auto p = binance::json::parser_pool::local().acquire();
+//   const json::object& jb = p->parse(buffer).root();
+//   ...  // p goes back to the pool when destroyed
+//
+// Parsers must be released on the thread that acquired them.
+class parser_pool
+{
+public:
+  struct recycle
+  {
+    parser_pool* pool;
+    void operator()(parser* p) const
+    {
+      pool->release(p);
+    }
+  };
+  using handle = std::unique_ptr<parser, recycle>;
+
+private:
+  std::vector<std::unique_ptr<parser>> idle_;
+  capacity_policy policy_;
+  size_t max_idle_;
+
+public:
+  parser_pool(const capacity_policy& policy = {}, size_t max_idle = 16)
+      : policy_(policy)
+      , max_idle_(max_idle)
+  {
+  }
+  parser_pool(const parser_pool&) = delete;
+  parser_pool& operator=(const parser_pool&) = delete;
+
+  // local returns the pool of the calling thread.
+  static parser_pool& local()
+  {
+    static thread_local parser_pool pool;
+    return pool;
+  }
+
+  handle acquire()
+  {
+    if (idle_.empty())
+      return handle(new parser(policy_), recycle{this});
+    parser* p = idle_.back().release();
+    idle_.pop_back();
+    return handle(p, recycle{this});
+  }
+
+  size_t idle() const
+  {
+    return idle_.size();
+  }
+
+private:
+  void release(parser* p)
+  {
+    std::unique_ptr<parser> owned(p);
+    if (idle_.size() >= max_idle_)
+      return;
+    owned->reset();
+    idle_.push_back(std::move(owned));
+  }
 };
 
+static_assert(simdjson::SIMDJSON_PADDING >= 16,
+              "conv::parse_int_padded needs 16 bytes of padding");
+
 using object = simdjson::dom::object;
 using array  = simdjson::dom::array;
 using value  = simdjson::dom::element;
@@ -65,9 +300,10 @@ really_inline int64_t to_int(const value& e)
     val = e;
   else
   {
+    // Ids and timestamps sent as strings ("U", "u", "pu", "T", ...) live in
+    // the parser's string buffer, which simdjson keeps padded.
     std::string_view S = e.get<std::string_view>();
-    const char* s      = S.data();
-    val                = binance::conv::parse_int(&s[0], S.size());
+    val = binance::conv::parse_int_padded(S.data(), S.size());
   }
 
   return val;
@@ -105,6 +341,11 @@ really_inline void value_to(const value& v, int& i)
   i = int(to_int(v));
 }
 
+really_inline void value_to(const value& v, bool& b)
+{
+  b = v;
+}
+
 really_inline void value_to(const value& v, std::string& s)
 {
   s = v;
@@ -165,8 +406,9 @@ really_inline void value_to(const object& jv, const char* key,
                             binance::error& v)
 {
   auto [ev, e] = jv[key];
-  if (!e)
-    v = ev;
+  std::string_view s;
+  if (!e && ev.get(s) == simdjson::SUCCESS)
+    v = s;
 }
 
 really_inline void value_to(const object& jv, const char* key, int64_t& v)
@@ -256,6 +498,48 @@ really_inline void value_to(const json::array& jr, std::vector<T>& v)
   }
 }
 
+// for_each decodes the elements of an array one by one into the same T and
+// calls f with each of them, without materializing a std::vector. Returns
+// the number of elements visited.
+template<class T, class F>
+really_inline size_t for_each(const json::array& jr, F&& f)
+{
+  T v;
+  size_t n = 0;
+  for (const auto& e : jr)
+  {
+    v = e;
+    f(v);
+    ++n;
+  }
+  return n;
+}
+
+// Same as above, decoding the field s of each element.
+template<class T, class F>
+really_inline size_t for_each(const json::array& jr, const char* s, F&& f)
+{
+  T v;
+  size_t n = 0;
+  for (const json::object& e : jr)
+  {
+    v = e[s];
+    f(v);
+    ++n;
+  }
+  return n;
+}
+
+// Same as above, for the array stored in key. Missing keys visit nothing.
+template<class T, class F>
+really_inline size_t for_each(const json::object& jb, const char* key, F&& f)
+{
+  json::array jr;
+  if (jb[key].get(jr) != simdjson::SUCCESS)
+    return 0;
+  return for_each<T>(jr, std::forward<F>(f));
+}
+
 template<class ChronoScale = std::chrono::milliseconds, class T, class... Args>
 really_inline void value_to(json::array::iterator it,
                             const json::array::iterator end, T& v, Args&... vs)
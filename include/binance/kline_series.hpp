@@ -0,0 +1,272 @@
+#ifndef BINANCE_KLINE_SERIES_HPP
+#define BINANCE_KLINE_SERIES_HPP
+
+#include <binance/common.hpp>
+#include <binance/json.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace binance
+{
+namespace detail
+{
+// 4 doubles. GCC and Clang lower it to AVX or to pairs of SSE2 registers,
+// depending on the -m flags. Only used for locals, so the ABI is unaffected.
+typedef double __v4d_t __attribute__((vector_size(32)));
+
+inline double __sum(const double* p, size_t n)
+{
+  __v4d_t acc = {0, 0, 0, 0};
+  size_t i    = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __v4d_t v;
+    std::memcpy(&v, p + i, sizeof(v));
+    acc += v;
+  }
+
+  double s = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++)
+    s += p[i];
+  return s;
+}
+
+// out[i] = p[i + 1] / p[i] - 1
+inline void __returns(const double* p, size_t n, double* out)
+{
+  size_t i = 0;
+  for (; i + 5 <= n; i += 4)
+  {
+    __v4d_t a, b;
+    std::memcpy(&a, p + i, sizeof(a));
+    std::memcpy(&b, p + i + 1, sizeof(b));
+    b = b / a - 1;
+    std::memcpy(out + i, &b, sizeof(b));
+  }
+  for (; i + 1 < n; i++)
+    out[i] = p[i + 1] / p[i] - 1;
+}
+
+// __rolling computes out[i] = op(p[i], ..., p[i + w - 1]) with van Herk/Gil-
+// Werman: a prefix and a suffix pass over blocks of w elements, 3 ops per
+// element whatever w is.
+template<class Op>
+inline void __rolling(const double* p, size_t n, size_t w, double* out,
+                      std::vector<double>& suffix, Op op)
+{
+  if (w == 0 || n < w)
+    return;
+
+  suffix.resize(n);
+  for (size_t b = 0; b < n; b += w)
+  {
+    size_t e      = std::min(b + w, n);
+    suffix[e - 1] = p[e - 1];
+    for (size_t i = e - 1; i-- > b;)
+      suffix[i] = op(p[i], suffix[i + 1]);
+  }
+
+  // the window [i, i + w) is the suffix of the block holding i combined with
+  // the prefix, up to i + w - 1, of the block holding i + w - 1.
+  double prefix = p[0];
+  for (size_t j = 1; j + 1 < w; j++)
+    prefix = op(prefix, p[j]);
+  for (size_t i = 0; i + w <= n; i++)
+  {
+    size_t j = i + w - 1;
+    prefix   = (j % w == 0) ? p[j] : op(prefix, p[j]);
+    out[i]   = op(suffix[i], prefix);
+  }
+}
+}  // namespace detail
+
+// kline_series stores klines by columns, one contiguous array per field, so
+// scans over millions of klines only touch the fields they need.
+//
+// REST responses (kline_series_data) and kline stream messages (update)
+// decode straight into the columns.
+class kline_series
+{
+public:
+  std::vector<time_point_t> open_time;
+  std::vector<time_point_t> close_time;
+  std::vector<double> open;
+  std::vector<double> high;
+  std::vector<double> low;
+  std::vector<double> close;
+  std::vector<double> volume;
+  std::vector<double> quote_volume;
+  std::vector<double> taker_base_vol;
+  std::vector<double> taker_quote_vol;
+  std::vector<int64_t> trades;
+
+private:
+  std::vector<double> tmp_;
+
+public:
+  size_t size() const
+  {
+    return open_time.size();
+  }
+  bool empty() const
+  {
+    return open_time.empty();
+  }
+
+  void reserve(size_t n)
+  {
+    for_each_column([n](auto& c) { c.reserve(n); });
+  }
+
+  void clear()
+  {
+    for_each_column([](auto& c) { c.clear(); });
+  }
+
+  // append decodes the rows of a /fapi/v1/klines response.
+  kline_series& append(const json::array& jb)
+  {
+    reserve(size() + jb.size());
+    for (const json::array& jr : jb)
+    {
+      time_point_t ot, ct;
+      double o, h, l, c, v, qv, tbv, tqv;
+      int64_t n;
+      json::value_to(jr.begin(), jr.end(), ot, o, h, l, c, v, ct, qv, n, tbv,
+                     tqv);
+      push_back(ot, ct, o, h, l, c, v, qv, tbv, tqv, n);
+    }
+    return *this;
+  }
+
+  kline_series& operator=(const json::array& jb)
+  {
+    clear();
+    return append(jb);
+  }
+
+  // update applies a kline stream message, the event or its "k" object: the
+  // open kline is updated in place until a new one starts.
+  kline_series& update(const json::object& jb)
+  {
+    json::object k = jb;
+    json::value_to(jb, "k", k);
+
+    time_point_t ot, ct;
+    double o = 0, h = 0, l = 0, c = 0, v = 0, qv = 0, tbv = 0, tqv = 0;
+    int64_t n = 0;
+    json::value_to(k, "t", ot);
+    json::value_to(k, "T", ct);
+    json::value_to(k, "o", o);
+    json::value_to(k, "h", h);
+    json::value_to(k, "l", l);
+    json::value_to(k, "c", c);
+    json::value_to(k, "v", v);
+    json::value_to(k, "q", qv);
+    json::value_to(k, "V", tbv);
+    json::value_to(k, "Q", tqv);
+    json::value_to(k, "n", n);
+
+    if (!empty() && open_time.back() == ot)
+    {
+      size_t i           = size() - 1;
+      close_time[i]      = ct;
+      open[i]            = o;
+      high[i]            = h;
+      low[i]             = l;
+      close[i]           = c;
+      volume[i]          = v;
+      quote_volume[i]    = qv;
+      taker_base_vol[i]  = tbv;
+      taker_quote_vol[i] = tqv;
+      trades[i]          = n;
+      return *this;
+    }
+
+    push_back(ot, ct, o, h, l, c, v, qv, tbv, tqv, n);
+    return *this;
+  }
+
+  // Aggregates over the rows [from, to).
+
+  double volume_sum(size_t from, size_t to) const
+  {
+    return detail::__sum(volume.data() + from, to - from);
+  }
+
+  double quote_volume_sum(size_t from, size_t to) const
+  {
+    return detail::__sum(quote_volume.data() + from, to - from);
+  }
+
+  // vwap returns the volume weighted average price of every trade in the
+  // rows, 0 if there was no volume.
+  double vwap(size_t from, size_t to) const
+  {
+    double v = volume_sum(from, to);
+    return v == 0 ? 0 : quote_volume_sum(from, to) / v;
+  }
+
+  // Series over all the rows, written to out.
+
+  // returns sets out[i] to the return of close from row i to i + 1.
+  void returns(std::vector<double>& out) const
+  {
+    out.resize(size() > 0 ? size() - 1 : 0);
+    detail::__returns(close.data(), size(), out.data());
+  }
+
+  // rolling_high sets out[i] to the highest high of the rows [i, i + w).
+  void rolling_high(size_t w, std::vector<double>& out)
+  {
+    out.resize(w > 0 && size() >= w ? size() - w + 1 : 0);
+    detail::__rolling(high.data(), size(), w, out.data(), tmp_,
+                      [](double a, double b) { return a > b ? a : b; });
+  }
+
+  // rolling_low sets out[i] to the lowest low of the rows [i, i + w).
+  void rolling_low(size_t w, std::vector<double>& out)
+  {
+    out.resize(w > 0 && size() >= w ? size() - w + 1 : 0);
+    detail::__rolling(low.data(), size(), w, out.data(), tmp_,
+                      [](double a, double b) { return a < b ? a : b; });
+  }
+
+private:
+  template<class F>
+  void for_each_column(F&& f)
+  {
+    f(open_time);
+    f(close_time);
+    f(open);
+    f(high);
+    f(low);
+    f(close);
+    f(volume);
+    f(quote_volume);
+    f(taker_base_vol);
+    f(taker_quote_vol);
+    f(trades);
+  }
+
+  void push_back(time_point_t ot, time_point_t ct, double o, double h, double l,
+                 double c, double v, double qv, double tbv, double tqv,
+                 int64_t n)
+  {
+    open_time.push_back(ot);
+    close_time.push_back(ct);
+    open.push_back(o);
+    high.push_back(h);
+    low.push_back(l);
+    close.push_back(c);
+    volume.push_back(v);
+    quote_volume.push_back(qv);
+    taker_base_vol.push_back(tbv);
+    taker_quote_vol.push_back(tqv);
+    trades.push_back(n);
+  }
+};
+}  // namespace binance
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef BINANCE_PADDED_BUFFER_HPP
+#define BINANCE_PADDED_BUFFER_HPP
+
+#include <simdjson.h>
+
+#include <binance/common.hpp>
+#include <boost/asio/buffer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace binance
+{
+// padded_buffer is a flat DynamicBuffer, like boost::beast::flat_buffer, that
+// keeps SIMDJSON_PADDING readable bytes after its storage. Frames and bodies
+// read into it can be parsed in place by json::parser, without the copy
+// simdjson makes for unpadded input.
+class padded_buffer
+{
+public:
+  using const_buffers_type   = boost::asio::const_buffer;
+  using mutable_buffers_type = boost::asio::mutable_buffer;
+
+  static constexpr size_t padding = simdjson::SIMDJSON_PADDING;
+
+private:
+  char* begin_;
+  char* in_;    // readable bytes
+  char* out_;   // prepared bytes
+  char* last_;  // end of the prepared bytes
+  char* end_;   // end of the storage, followed by the padding
+  size_t max_;
+
+public:
+  explicit padded_buffer(
+      size_t limit = (std::numeric_limits<size_t>::max)() - padding)
+      : begin_(nullptr)
+      , in_(nullptr)
+      , out_(nullptr)
+      , last_(nullptr)
+      , end_(nullptr)
+      , max_(limit)
+  {
+  }
+  padded_buffer(const padded_buffer&) = delete;
+  padded_buffer& operator=(const padded_buffer&) = delete;
+  padded_buffer(padded_buffer&& o) noexcept
+      : begin_(o.begin_)
+      , in_(o.in_)
+      , out_(o.out_)
+      , last_(o.last_)
+      , end_(o.end_)
+      , max_(o.max_)
+  {
+    o.begin_ = o.in_ = o.out_ = o.last_ = o.end_ = nullptr;
+  }
+  padded_buffer& operator=(padded_buffer&& o) noexcept
+  {
+    if (this != &o)
+    {
+      delete[] begin_;
+      begin_   = o.begin_;
+      in_      = o.in_;
+      out_     = o.out_;
+      last_    = o.last_;
+      end_     = o.end_;
+      max_     = o.max_;
+      o.begin_ = o.in_ = o.out_ = o.last_ = o.end_ = nullptr;
+    }
+    return *this;
+  }
+  ~padded_buffer()
+  {
+    delete[] begin_;
+  }
+
+  size_t size() const
+  {
+    return size_t(out_ - in_);
+  }
+  size_t max_size() const
+  {
+    return max_;
+  }
+  size_t capacity() const
+  {
+    return size_t(end_ - begin_);
+  }
+
+  const_buffers_type data() const
+  {
+    return {in_, size()};
+  }
+  mutable_buffers_type data()
+  {
+    return {in_, size()};
+  }
+  const_buffers_type cdata() const
+  {
+    return data();
+  }
+
+  mutable_buffers_type prepare(size_t n)
+  {
+    const size_t len = size();
+    if (n > max_ - len)
+      throw std::length_error{"padded_buffer overflow"};
+
+    if (n > size_t(end_ - out_))
+    {
+      if (len + n <= capacity())
+      {
+        if (len > 0)
+          std::memmove(begin_, in_, len);
+      }
+      else
+        grow(std::min(std::max(capacity() * 2, len + n), max_));
+      in_  = begin_;
+      out_ = begin_ + len;
+    }
+    last_ = out_ + n;
+    return {out_, n};
+  }
+
+  void commit(size_t n)
+  {
+    out_ += std::min(n, size_t(last_ - out_));
+  }
+
+  void consume(size_t n)
+  {
+    if (n >= size())
+    {
+      in_ = out_ = begin_;
+      return;
+    }
+    in_ += n;
+  }
+
+  void clear()
+  {
+    in_ = out_ = last_ = begin_;
+  }
+
+  void reserve(size_t n)
+  {
+    if (n > capacity())
+      grow(std::min(n, max_));
+  }
+
+  void shrink_to_fit()
+  {
+    const size_t len = size();
+    if (len == capacity())
+      return;
+    if (len == 0)
+    {
+      delete[] begin_;
+      begin_ = in_ = out_ = last_ = end_ = nullptr;
+      return;
+    }
+    grow(len);
+  }
+
+private:
+  // grow moves the readable bytes to a new storage of n bytes.
+  void grow(size_t n)
+  {
+    const size_t len = size();
+    char* p          = new char[n + padding];
+    std::memset(p + n, 0, padding);
+    if (len > 0)
+      std::memcpy(p, in_, len);
+    delete[] begin_;
+    begin_ = p;
+    in_    = p;
+    out_   = p + len;
+    last_  = out_;
+    end_   = p + n;
+  }
+};
+}  // namespace binance
+
+#endif
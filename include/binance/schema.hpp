@@ -0,0 +1,495 @@
+#ifndef BINANCE_SCHEMA_HPP
+#define BINANCE_SCHEMA_HPP
+
+#include <binance/common.hpp>
+#include <binance/json.hpp>
+#include <binance/symbols.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Messages describe their fields once, in a table of (json key, member)
+// pairs, and everything else is generated from it: the json decoder, the json
+// encoder, operator==, visit_strings and a binary layout.
+//
+//   struct book_ticker
+//   {
+//     int64_t order_book_id;  // u
+//     std::string_view symbol;
+//     symbol_id sym_id;
+//     ...
+//     BINANCE_SCHEMA(book_ticker,
+//                    schema::make("u", &self::order_book_id),
+//                    schema::make("s", &self::symbol, &self::sym_id), ...)
+//   };
+//
+// Messages sent as json arrays ([price, qty]) use BINANCE_SCHEMA_ARRAY, where
+// fields are matched by position and the keys are only documentation.
+namespace binance
+{
+namespace schema
+{
+// field maps a json key to a member.
+template<class T, class M>
+struct field
+{
+  using member_type = M;
+  const char* key;
+  M T::*member;
+};
+
+// interned is a symbol field. Decoding it also resolves its symbol_id.
+template<class T, class M>
+struct interned : public field<T, M>
+{
+  symbol_id T::*id;
+};
+
+template<class T, class M>
+constexpr field<T, M> make(const char* key, M T::*member)
+{
+  return {key, member};
+}
+
+template<class T, class M>
+constexpr interned<T, M> make(const char* key, M T::*member, symbol_id T::*id)
+{
+  return {{key, member}, id};
+}
+
+template<class T, class = void>
+struct has_fields : std::false_type
+{
+};
+
+template<class T>
+struct has_fields<T, std::void_t<decltype(T::fields())>> : std::true_type
+{
+};
+
+template<class T, class = void>
+struct is_positional : std::false_type
+{
+};
+
+template<class T>
+struct is_positional<T, std::void_t<decltype(T::positional)>>
+    : std::bool_constant<T::positional>
+{
+};
+
+template<class F>
+struct is_interned : std::false_type
+{
+};
+
+template<class T, class M>
+struct is_interned<interned<T, M>> : std::true_type
+{
+};
+
+template<class T>
+struct is_vector : std::false_type
+{
+};
+
+template<class T>
+struct is_vector<std::vector<T>> : std::true_type
+{
+};
+
+// for_each_field calls f with every field of T, in order.
+template<class T, class F>
+really_inline void for_each_field(F&& f)
+{
+  std::apply([&f](const auto&... fs) { (f(fs), ...); }, T::fields());
+}
+
+/**
+ * json decoding
+ **/
+
+template<class T>
+really_inline void decode(const json::object& jb, T& v)
+{
+  for_each_field<T>([&](const auto& fd) {
+    auto& m = v.*fd.member;
+    json::value_to(jb, fd.key, m);
+    if constexpr (is_interned<std::decay_t<decltype(fd)>>::value)
+      v.*fd.id = symbol_of(m);
+  });
+}
+
+template<class T>
+really_inline void decode(const json::array& jr, T& v)
+{
+  auto it  = jr.begin();
+  auto end = jr.end();
+  for_each_field<T>([&](const auto& fd) {
+    if (it == end)
+      return;
+    json::value_to(*it, v.*fd.member);
+    ++it;
+  });
+}
+
+/**
+ * equality
+ **/
+
+template<class T>
+really_inline bool equal(const T& a, const T& b)
+{
+  bool eq = true;
+  for_each_field<T>(
+      [&](const auto& fd) { eq = eq && a.*fd.member == b.*fd.member; });
+  return eq;
+}
+
+/**
+ * string members, see arena
+ **/
+
+template<class T, class F>
+really_inline void visit_strings(T& v, F& f);
+
+namespace detail
+{
+template<class M, class F>
+really_inline void __visit_strings(M& m, F& f)
+{
+  if constexpr (std::is_same_v<M, std::string_view>)
+    f(m);
+  else if constexpr (has_fields<M>::value)
+    visit_strings(m, f);
+  else if constexpr (is_vector<M>::value)
+  {
+    for (auto& e : m)
+      __visit_strings(e, f);
+  }
+}
+}  // namespace detail
+
+// visit_strings calls f with every string_view of v, including the ones in
+// nested messages and vectors.
+template<class T, class F>
+really_inline void visit_strings(T& v, F& f)
+{
+  for_each_field<T>(
+      [&](const auto& fd) { detail::__visit_strings(v.*fd.member, f); });
+}
+
+/**
+ * json encoding
+ **/
+
+template<class T>
+void to_json(const T& v, std::string& out);
+
+namespace detail
+{
+template<class M>
+really_inline void __append_number(std::string& out, M v)
+{
+  char buf[32];
+  auto r = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, r.ptr);
+}
+
+really_inline void __append_string(std::string& out, std::string_view s)
+{
+  out += '"';
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  out += '"';
+}
+
+template<class M>
+void __append_value(std::string& out, const M& m)
+{
+  if constexpr (std::is_same_v<M, bool>)
+    out += m ? "true" : "false";
+  else if constexpr (std::is_arithmetic_v<M>)
+    __append_number(out, m);
+  else if constexpr (std::is_same_v<M, time_point_t>)
+    __append_number(out, std::chrono::duration_cast<std::chrono::milliseconds>(
+                             m.time_since_epoch())
+                             .count());
+  else if constexpr (std::is_convertible_v<const M&, std::string_view>)
+    __append_string(out, m);
+  else if constexpr (is_vector<M>::value)
+  {
+    out += '[';
+    for (size_t i = 0; i < m.size(); i++)
+    {
+      if (i > 0)
+        out += ',';
+      __append_value(out, m[i]);
+    }
+    out += ']';
+  }
+  else
+    to_json(m, out);
+}
+}  // namespace detail
+
+// to_json appends v to out, in the format it is decoded from.
+template<class T>
+void to_json(const T& v, std::string& out)
+{
+  constexpr bool positional = is_positional<T>::value;
+  out += positional ? '[' : '{';
+  bool first = true;
+  for_each_field<T>([&](const auto& fd) {
+    if (!first)
+      out += ',';
+    first = false;
+    if constexpr (!positional)
+    {
+      detail::__append_string(out, fd.key);
+      out += ':';
+    }
+    detail::__append_value(out, v.*fd.member);
+  });
+  out += positional ? ']' : '}';
+}
+
+template<class T>
+std::string to_json(const T& v)
+{
+  std::string out;
+  to_json(v, out);
+  return out;
+}
+
+/**
+ * binary layout
+ *
+ * Fields are written in table order, in native byte order: arithmetic types
+ * as is, time_point_t as its int64_t tick count, strings as a uint32_t length
+ * followed by the bytes and vectors as a uint32_t count followed by the
+ * elements. symbol_ids are not written, they are resolved again on read.
+ **/
+
+template<class T>
+void write(const T& v, std::string& out);
+template<class T>
+bool read(const char*& p, const char* end, T& v);
+
+namespace detail
+{
+template<class M>
+really_inline void __write_raw(std::string& out, const M& m)
+{
+  out.append(reinterpret_cast<const char*>(&m), sizeof(M));
+}
+
+template<class M>
+really_inline bool __read_raw(const char*& p, const char* end, M& m)
+{
+  if (size_t(end - p) < sizeof(M))
+    return false;
+  std::memcpy(&m, p, sizeof(M));
+  p += sizeof(M);
+  return true;
+}
+
+template<class M>
+void __write_value(std::string& out, const M& m)
+{
+  if constexpr (std::is_arithmetic_v<M>)
+    __write_raw(out, m);
+  else if constexpr (std::is_same_v<M, time_point_t>)
+    __write_raw(out, int64_t(m.time_since_epoch().count()));
+  else if constexpr (std::is_convertible_v<const M&, std::string_view>)
+  {
+    std::string_view s = m;
+    __write_raw(out, uint32_t(s.size()));
+    out.append(s.data(), s.size());
+  }
+  else if constexpr (is_vector<M>::value)
+  {
+    __write_raw(out, uint32_t(m.size()));
+    for (const auto& e : m)
+      __write_value(out, e);
+  }
+  else
+    write(m, out);
+}
+
+// __min_size returns the fewest bytes the binary layout of M takes, which
+// bounds the element count a vector can claim before it is allocated.
+template<class M>
+constexpr size_t __min_size();
+
+template<class Fields, size_t... I>
+constexpr size_t __min_size_of(std::index_sequence<I...>)
+{
+  return (size_t(0) + ...
+          + __min_size<
+              typename std::tuple_element_t<I, Fields>::member_type>());
+}
+
+template<class M>
+constexpr size_t __min_size()
+{
+  if constexpr (std::is_arithmetic_v<M>)
+    return sizeof(M);
+  else if constexpr (std::is_same_v<M, time_point_t>)
+    return sizeof(int64_t);
+  else if constexpr (has_fields<M>::value)
+  {
+    using F = decltype(M::fields());
+    return std::max<size_t>(
+        __min_size_of<F>(std::make_index_sequence<std::tuple_size_v<F>>()), 1);
+  }
+  else
+    return sizeof(uint32_t);  // the size of a string or vector
+}
+
+// strings read into a std::string_view point into the input.
+template<class M>
+bool __read_value(const char*& p, const char* end, M& m)
+{
+  if constexpr (std::is_arithmetic_v<M>)
+    return __read_raw(p, end, m);
+  else if constexpr (std::is_same_v<M, time_point_t>)
+  {
+    int64_t n;
+    if (!__read_raw(p, end, n))
+      return false;
+    m = time_point_t(time_point_t::duration(n));
+    return true;
+  }
+  else if constexpr (std::is_same_v<M, std::string_view>
+                     || std::is_same_v<M, std::string>)
+  {
+    uint32_t n;
+    if (!__read_raw(p, end, n) || size_t(end - p) < n)
+      return false;
+    m = M(p, n);
+    p += n;
+    return true;
+  }
+  else if constexpr (is_vector<M>::value)
+  {
+    // a corrupt count must not allocate more than the input can hold.
+    uint32_t n;
+    if (!__read_raw(p, end, n)
+        || size_t(end - p) / __min_size<typename M::value_type>() < n)
+      return false;
+    m.resize(n);
+    for (auto& e : m)
+    {
+      if (!__read_value(p, end, e))
+        return false;
+    }
+    return true;
+  }
+  else
+    return read(p, end, m);
+}
+}  // namespace detail
+
+// write appends the binary layout of v to out.
+template<class T>
+void write(const T& v, std::string& out)
+{
+  for_each_field<T>(
+      [&](const auto& fd) { detail::__write_value(out, v.*fd.member); });
+}
+
+// read decodes v from [p, end) and moves p past it. Returns false if the
+// input is truncated.
+template<class T>
+bool read(const char*& p, const char* end, T& v)
+{
+  bool ok = true;
+  for_each_field<T>([&](const auto& fd) {
+    if (!ok)
+      return;
+    auto& m = v.*fd.member;
+    ok      = detail::__read_value(p, end, m);
+    if constexpr (is_interned<std::decay_t<decltype(fd)>>::value)
+      v.*fd.id = ok ? symbol_of(m) : invalid_symbol;
+  });
+  return ok;
+}
+}  // namespace schema
+}  // namespace binance
+
+#define __BINANCE_SCHEMA_MEMBERS(T)                          \
+  bool operator==(const T& o) const                          \
+  {                                                          \
+    return binance::schema::equal(*this, o);                 \
+  }                                                          \
+  bool operator!=(const T& o) const                          \
+  {                                                          \
+    return !(*this == o);                                    \
+  }                                                          \
+  template<class F>                                          \
+  void visit_strings(F&& f)                                  \
+  {                                                          \
+    binance::schema::visit_strings(*this, f);                \
+  }
+
+// BINANCE_SCHEMA declares the fields of T, a message decoded from a json
+// object. `self` names T inside the table.
+#define BINANCE_SCHEMA(T, ...)                               \
+  static constexpr auto fields()                             \
+  {                                                          \
+    using self = T;                                          \
+    return std::make_tuple(__VA_ARGS__);                     \
+  }                                                          \
+  T& operator=(const binance::json::object& jb)              \
+  {                                                          \
+    binance::schema::decode(jb, *this);                      \
+    return *this;                                            \
+  }                                                          \
+  __BINANCE_SCHEMA_MEMBERS(T)
+
+// BINANCE_SCHEMA_EXTENDS is BINANCE_SCHEMA for a message that adds fields to
+// the ones of Base.
+#define BINANCE_SCHEMA_EXTENDS(T, Base, ...)                 \
+  static constexpr auto fields()                             \
+  {                                                          \
+    using self = T;                                          \
+    return std::tuple_cat(Base::fields(),                    \
+                          std::make_tuple(__VA_ARGS__));     \
+  }                                                          \
+  T& operator=(const binance::json::object& jb)              \
+  {                                                          \
+    binance::schema::decode(jb, *this);                      \
+    return *this;                                            \
+  }                                                          \
+  __BINANCE_SCHEMA_MEMBERS(T)
+
+// BINANCE_SCHEMA_ARRAY declares the fields of T, a message decoded from a
+// json array.
+#define BINANCE_SCHEMA_ARRAY(T, ...)                         \
+  static constexpr bool positional = true;                   \
+  static constexpr auto fields()                             \
+  {                                                          \
+    using self = T;                                          \
+    return std::make_tuple(__VA_ARGS__);                     \
+  }                                                          \
+  T& operator=(const binance::json::array& jr)               \
+  {                                                          \
+    binance::schema::decode(jr, *this);                      \
+    return *this;                                            \
+  }                                                          \
+  __BINANCE_SCHEMA_MEMBERS(T)
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef BINANCE_SYMBOLS_HPP
+#define BINANCE_SYMBOLS_HPP
+
+#include <binance/common.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace binance
+{
+// symbol_id is a dense index (0, 1, 2...) assigned by symbol_registry, so
+// per-symbol state can live in flat arrays.
+using symbol_id = uint32_t;
+
+constexpr symbol_id invalid_symbol = std::numeric_limits<symbol_id>::max();
+
+// symbol_name stores a symbol inline, without heap allocations.
+class symbol_name
+{
+public:
+  static constexpr std::size_t capacity = 31;
+
+private:
+  uint8_t size_;
+  char data_[capacity];
+
+public:
+  symbol_name()
+      : size_(0)
+  {
+  }
+  // names longer than capacity are truncated, use fits() to check first.
+  symbol_name(std::string_view s)
+      : size_(uint8_t(std::min(s.size(), capacity)))
+  {
+    std::memcpy(data_, s.data(), size_);
+  }
+  static bool fits(std::string_view s)
+  {
+    return s.size() <= capacity;
+  }
+  std::size_t size() const
+  {
+    return size_;
+  }
+  const char* data() const
+  {
+    return data_;
+  }
+  operator std::string_view() const
+  {
+    return std::string_view(data_, size_);
+  }
+  bool operator==(std::string_view s) const
+  {
+    return s.size() == size_ && std::memcmp(data_, s.data(), size_) == 0;
+  }
+};
+
+// symbol_registry maps symbols to symbol_id through a perfect hash built with
+// hash-and-displace: every key hashes into a bucket, and every bucket gets the
+// seed that sends all of its keys to free slots. A lookup is one hash, two
+// array reads and a compare.
+//
+// Usually built from exchange_info:
+//
+//   binance::symbol_registry symbols(exi->symbols);
+//   symbols.install();  // messages resolve `sym_id` from now on
+//
+// The ids of a registry built from a range are the positions in the range, so
+// `exi->symbols[id]` is the symbol of id. Duplicated or too long names keep
+// their position but are never found.
+class symbol_registry
+{
+  std::vector<symbol_name> names_;
+  std::vector<uint32_t> seeds_;
+  std::vector<symbol_id> slots_;
+  uint64_t slot_mask_;
+  uint64_t bucket_mask_;
+  uint32_t fingerprint_;
+
+public:
+  symbol_registry()
+      : slot_mask_(0)
+      , bucket_mask_(0)
+      , fingerprint_(0)
+  {
+  }
+  // builds the registry from exchange_info::symbols, or any range of elements
+  // with a `symbol` member.
+  template<class Range>
+  explicit symbol_registry(const Range& symbols)
+      : symbol_registry()
+  {
+    for (const auto& v : symbols)
+      push(v.symbol);
+    build();
+  }
+  explicit symbol_registry(std::initializer_list<std::string_view> symbols)
+      : symbol_registry()
+  {
+    for (auto s : symbols)
+      push(s);
+    build();
+  }
+
+  std::size_t size() const
+  {
+    return names_.size();
+  }
+  bool empty() const
+  {
+    return names_.empty();
+  }
+  // name returns the symbol for the id, which must be valid. Names skipped by
+  // the constructors are empty.
+  const symbol_name& name(symbol_id id) const
+  {
+    return names_[id];
+  }
+
+  // insert adds a symbol and returns its id, or the current id if it
+  // was already there. Returns invalid_symbol if the name is too long.
+  symbol_id insert(std::string_view s)
+  {
+    symbol_id id = find(s);
+    if (id != invalid_symbol || s.empty() || !symbol_name::fits(s))
+      return id;
+
+    id = add(s);
+    build();
+    return id;
+  }
+
+  // find returns the id of the symbol (case sensitive, as sent by the
+  // exchange) or invalid_symbol.
+  really_inline symbol_id find(std::string_view s) const
+  {
+    if (slots_.empty())
+      return invalid_symbol;
+
+    uint64_t h    = hash(s);
+    uint32_t seed = seeds_[(h >> 32) & bucket_mask_];
+    symbol_id id  = slots_[mix(h ^ seed) & slot_mask_];
+    if (id != invalid_symbol && names_[id] == s)
+      return id;
+    return invalid_symbol;
+  }
+
+  // find_any_case is find for user provided symbols, e.g. `btcusdt`.
+  symbol_id find_any_case(std::string_view s) const
+  {
+    if (!symbol_name::fits(s))
+      return invalid_symbol;
+
+    char upper[symbol_name::capacity];
+    for (std::size_t i = 0; i < s.size(); i++)
+      upper[i] = (s[i] >= 'a' && s[i] <= 'z') ? char(s[i] - 32) : s[i];
+    return find(std::string_view(upper, s.size()));
+  }
+
+  // fingerprint identifies the names and their ids, so two registries built
+  // from the same list have the same one. Never 0.
+  uint32_t fingerprint() const
+  {
+    return fingerprint_;
+  }
+
+  // make_table returns an array with one element per symbol, to be indexed
+  // by symbol_id.
+  template<class T>
+  std::vector<T> make_table(const T& init = T()) const
+  {
+    return std::vector<T>(size(), init);
+  }
+
+  // install makes a copy of this registry the one used by the message
+  // decoders, so this one can be moved or destroyed. Symbols inserted later
+  // are only seen once it is installed again. It may be called while streams
+  // decode on other threads: the registries it replaces are kept until exit,
+  // as names may still be read from them, so install once per exchange_info
+  // refresh rather than per message.
+  void install() const;
+
+  static really_inline uint64_t hash(std::string_view s)
+  {
+    const char* p = s.data();
+    std::size_t n = s.size();
+    uint64_t h    = n * 0x9e3779b97f4a7c15;
+    for (; n >= 8; p += 8, n -= 8)
+    {
+      uint64_t w;
+      std::memcpy(&w, p, 8);
+      h = mix(h ^ w);
+    }
+    if (n > 0)
+    {
+      uint64_t w = 0;
+      for (std::size_t i = 0; i < n; i++)
+        w |= uint64_t(uint8_t(p[i])) << (8 * i);
+      h = mix(h ^ w);
+    }
+    return h;
+  }
+
+private:
+  // splitmix64 finalizer
+  static really_inline uint64_t mix(uint64_t h)
+  {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+    return h ^ (h >> 31);
+  }
+
+  symbol_id add(std::string_view s)
+  {
+    names_.emplace_back(s);
+    return symbol_id(names_.size() - 1);
+  }
+
+  // push adds a slot for every name, an empty one if the name is repeated or
+  // too long, so ids follow the input.
+  void push(std::string_view s)
+  {
+    if (s.empty() || !symbol_name::fits(s)
+        || std::find(names_.begin(), names_.end(), s) != names_.end())
+      names_.emplace_back();
+    else
+      names_.emplace_back(s);
+  }
+
+  static uint64_t next_pow2(uint64_t n)
+  {
+    uint64_t v = 1;
+    while (v < n)
+      v <<= 1;
+    return v;
+  }
+
+  void build()
+  {
+    // load factor <= 0.5 and ~4 keys per bucket keep the seed search short.
+    uint64_t n_slots   = next_pow2(std::max<uint64_t>(names_.size() * 2, 1));
+    uint64_t n_buckets = next_pow2(std::max<uint64_t>(names_.size() / 4, 1));
+    slot_mask_         = n_slots - 1;
+    bucket_mask_       = n_buckets - 1;
+
+    // FNV-1a of the names, each followed by a 0.
+    fingerprint_ = 2166136261u;
+    for (const auto& name : names_)
+    {
+      for (char c : std::string_view(name))
+        fingerprint_ = (fingerprint_ ^ uint8_t(c)) * 16777619u;
+      fingerprint_ *= 16777619u;
+    }
+    if (fingerprint_ == 0)
+      fingerprint_ = 1;
+
+    std::vector<std::vector<std::pair<symbol_id, uint64_t>>> buckets(n_buckets);
+    for (symbol_id id = 0; id < names_.size(); id++)
+    {
+      if (names_[id].size() == 0)
+        continue;
+      uint64_t h = hash(names_[id]);
+      buckets[(h >> 32) & bucket_mask_].emplace_back(id, h);
+    }
+
+    std::vector<uint64_t> order(n_buckets);
+    for (uint64_t i = 0; i < n_buckets; i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+
+    seeds_.assign(n_buckets, 0);
+    slots_.assign(n_slots, invalid_symbol);
+
+    std::vector<uint64_t> taken;
+    for (uint64_t b : order)
+    {
+      const auto& keys = buckets[b];
+      if (keys.empty())
+        break;
+
+      for (uint32_t seed = 1;; seed++)
+      {
+        taken.clear();
+        bool ok = true;
+        for (const auto& [id, h] : keys)
+        {
+          uint64_t slot = mix(h ^ seed) & slot_mask_;
+          if (slots_[slot] != invalid_symbol
+              || std::find(taken.begin(), taken.end(), slot) != taken.end())
+          {
+            ok = false;
+            break;
+          }
+          taken.push_back(slot);
+        }
+        if (!ok)
+          continue;
+
+        seeds_[b] = seed;
+        for (std::size_t i = 0; i < keys.size(); i++)
+          slots_[taken[i]] = keys[i].first;
+        break;
+      }
+    }
+  }
+};
+
+namespace detail
+{
+inline std::atomic<const symbol_registry*> __symbols{nullptr};
+// every registry installed, never freed: a decoder may still hold the one
+// replaced.
+inline std::mutex __installed_mutex;
+inline std::vector<std::unique_ptr<const symbol_registry>> __installed;
+}  // namespace detail
+
+inline void symbol_registry::install() const
+{
+  auto r = std::make_unique<const symbol_registry>(*this);
+  std::lock_guard<std::mutex> lock(detail::__installed_mutex);
+  detail::__symbols.store(r.get(), std::memory_order_release);
+  detail::__installed.push_back(std::move(r));
+}
+
+// installed_symbols returns the installed registry, or null. It stays valid
+// after another one is installed.
+inline const symbol_registry* installed_symbols()
+{
+  return detail::__symbols.load(std::memory_order_acquire);
+}
+
+// symbol_of resolves a symbol through the installed registry. Returns
+// invalid_symbol if there is none or the symbol is unknown.
+really_inline symbol_id symbol_of(std::string_view s)
+{
+  const symbol_registry* r = installed_symbols();
+  return r ? r->find(s) : invalid_symbol;
+}
+}  // namespace binance
+
+#endif
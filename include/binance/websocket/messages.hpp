@@ -2,6 +2,8 @@
 #define BINANCE_WEBSOCKET_MESSAGES_HPP
 
 #include <binance/json.hpp>
+#include <binance/schema.hpp>
+#include <binance/symbols.hpp>
 
 namespace binance
 {
@@ -9,29 +11,26 @@ namespace websocket
 {
 namespace messages
 {
-#define _value_to(x, e) json::value_to(jb, x, e)
 // https://binance-docs.github.io/apidocs/futures/en/#mark-price-stream
 struct mark_price
 {
   std::string_view event_type;  // e
   std::string_view symbol;      // s
+  symbol_id sym_id;             // s (interned)
   time_point_t event_time;      // E
   time_point_t next_fund_time;  // T
   double price;                 // p
   double index_price;           // i
   double funding_rate;          // r
 
-  mark_price& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("s", symbol);
-    _value_to("E", event_time);
-    _value_to("T", next_fund_time);
-    _value_to("p", price);
-    _value_to("i", index_price);
-    _value_to("r", funding_rate);
-    return *this;
-  }
+  BINANCE_SCHEMA(mark_price,
+                 schema::make("e", &self::event_type),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("E", &self::event_time),
+                 schema::make("T", &self::next_fund_time),
+                 schema::make("p", &self::price),
+                 schema::make("i", &self::index_price),
+                 schema::make("r", &self::funding_rate))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#mark-price-stream-for-all-market
 struct mark_price_all
@@ -42,6 +41,12 @@ struct mark_price_all
     json::value_to(jb, marks);
     return *this;
   }
+  // for_each decodes the elements one by one, see json::for_each.
+  template<class F>
+  static size_t for_each(const json::array& jb, F&& f)
+  {
+    return json::for_each<mark_price>(jb, std::forward<F>(f));
+  }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#kline-candlestick-data
 struct kline
@@ -49,6 +54,7 @@ struct kline
   time_point_t start_time;     // t
   time_point_t close_time;     // T
   std::string_view symbol;     // s
+  symbol_id sym_id;            // s (interned)
   std::string_view interval;   // i
   int64_t first_trade_id;      // f
   int64_t last_trade_id;       // L
@@ -63,33 +69,30 @@ struct kline
   double taker_base_buy_vol;   // V
   double taker_quote_buy_vol;  // Q
 
-  kline& operator=(const json::object& jb)
-  {
-    _value_to("s", symbol);
-    _value_to("t", start_time);
-    _value_to("T", close_time);
-    _value_to("i", interval);
-    _value_to("f", first_trade_id);
-    _value_to("L", last_trade_id);
-    _value_to("o", open_price);
-    _value_to("c", close_price);
-    _value_to("h", high_price);
-    _value_to("l", low_price);
-    _value_to("v", base_volume);
-    _value_to("n", trades);
-    _value_to("x", closed);
-    _value_to("q", quote_volume);
-    _value_to("n", trades);
-    _value_to("V", taker_base_buy_vol);
-    _value_to("Q", taker_quote_buy_vol);
-    return *this;
-  }
+  BINANCE_SCHEMA(kline,
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("t", &self::start_time),
+                 schema::make("T", &self::close_time),
+                 schema::make("i", &self::interval),
+                 schema::make("f", &self::first_trade_id),
+                 schema::make("L", &self::last_trade_id),
+                 schema::make("o", &self::open_price),
+                 schema::make("c", &self::close_price),
+                 schema::make("h", &self::high_price),
+                 schema::make("l", &self::low_price),
+                 schema::make("v", &self::base_volume),
+                 schema::make("n", &self::trades),
+                 schema::make("x", &self::closed),
+                 schema::make("q", &self::quote_volume),
+                 schema::make("V", &self::taker_base_buy_vol),
+                 schema::make("Q", &self::taker_quote_buy_vol))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#individual-symbol-mini-ticker-stream
 struct mini_ticker
 {
   std::string_view event_type;  // e
   std::string_view symbol;      // s
+  symbol_id sym_id;             // s (interned)
   time_point_t event_time;      // E
   double close_price;           // c
   double open_price;            // o
@@ -97,35 +100,39 @@ struct mini_ticker
   double low_price;             // l
   double base_vol;              // v
   double quote_vol;             // q
-  mini_ticker& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("s", symbol);
-    _value_to("E", event_time);
-    _value_to("c", close_price);
-    _value_to("o", open_price);
-    _value_to("h", high_price);
-    _value_to("l", low_price);
-    _value_to("v", base_vol);
-    _value_to("q", quote_vol);
-    return *this;
-  }
+  BINANCE_SCHEMA(mini_ticker,
+                 schema::make("e", &self::event_type),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("E", &self::event_time),
+                 schema::make("c", &self::close_price),
+                 schema::make("o", &self::open_price),
+                 schema::make("h", &self::high_price),
+                 schema::make("l", &self::low_price),
+                 schema::make("v", &self::base_vol),
+                 schema::make("q", &self::quote_vol))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#all-market-mini-tickers-stream
 struct mini_ticker_all
 {
-  std::vector<mark_price> tickers;
+  std::vector<mini_ticker> tickers;
   mini_ticker_all& operator=(const json::array& jb)
   {
     json::value_to(jb, tickers);
     return *this;
   }
+  // for_each decodes the elements one by one, see json::for_each.
+  template<class F>
+  static size_t for_each(const json::array& jb, F&& f)
+  {
+    return json::for_each<mini_ticker>(jb, std::forward<F>(f));
+  }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#individual-symbol-ticker-streams
 struct ticker
 {
   std::string_view event_type;  // e
   std::string_view symbol;      // s
+  symbol_id sym_id;             // s (interned)
   double price_change;          // p
   double price_change_pct;      // P
   double w_avg_price;           // w
@@ -142,28 +149,25 @@ struct ticker
   int64_t first_trade_id;       // F
   int64_t last_trade_id;        // L
   int64_t trades;               // n
-  ticker& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("s", symbol);
-    _value_to("p", price_change);
-    _value_to("P", price_change_pct);
-    _value_to("w", w_avg_price);
-    _value_to("c", last_price);
-    _value_to("Q", last_qty);
-    _value_to("o", open_price);
-    _value_to("h", high_price);
-    _value_to("l", low_price);
-    _value_to("v", base_vol);
-    _value_to("q", quote_vol);
-    _value_to("E", event_time);
-    _value_to("O", st_open_time);
-    _value_to("C", st_close_time);
-    _value_to("F", first_trade_id);
-    _value_to("L", last_trade_id);
-    _value_to("n", trades);
-    return *this;
-  }
+  BINANCE_SCHEMA(ticker,
+                 schema::make("e", &self::event_type),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("p", &self::price_change),
+                 schema::make("P", &self::price_change_pct),
+                 schema::make("w", &self::w_avg_price),
+                 schema::make("c", &self::last_price),
+                 schema::make("Q", &self::last_qty),
+                 schema::make("o", &self::open_price),
+                 schema::make("h", &self::high_price),
+                 schema::make("l", &self::low_price),
+                 schema::make("v", &self::base_vol),
+                 schema::make("q", &self::quote_vol),
+                 schema::make("E", &self::event_time),
+                 schema::make("O", &self::st_open_time),
+                 schema::make("C", &self::st_close_time),
+                 schema::make("F", &self::first_trade_id),
+                 schema::make("L", &self::last_trade_id),
+                 schema::make("n", &self::trades))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#all-market-tickers-streams
 struct ticker_all
@@ -174,6 +178,12 @@ struct ticker_all
     json::value_to(jb, tickers);
     return *this;
   }
+  // for_each decodes the elements one by one, see json::for_each.
+  template<class F>
+  static size_t for_each(const json::array& jb, F&& f)
+  {
+    return json::for_each<ticker>(jb, std::forward<F>(f));
+  }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#individual-symbol-book-ticker-streams
 struct book_ticker
@@ -182,22 +192,20 @@ struct book_ticker
   int64_t transaction_time;  // T
   time_point_t event_time;   // E
   std::string_view symbol;   // s
+  symbol_id sym_id;          // s (interned)
   double best_bid_price;     // b
   double best_bid_qty;       // B
   double best_ask_price;     // a
   double best_ask_qty;       // A
-  book_ticker& operator=(const json::object& jb)
-  {
-    _value_to("u", order_book_id);
-    _value_to("T", transaction_time);
-    _value_to("E", event_time);
-    _value_to("s", symbol);
-    _value_to("b", best_bid_price);
-    _value_to("B", best_bid_qty);
-    _value_to("a", best_ask_price);
-    _value_to("A", best_ask_qty);
-    return *this;
-  }
+  BINANCE_SCHEMA(book_ticker,
+                 schema::make("u", &self::order_book_id),
+                 schema::make("T", &self::transaction_time),
+                 schema::make("E", &self::event_time),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("b", &self::best_bid_price),
+                 schema::make("B", &self::best_bid_qty),
+                 schema::make("a", &self::best_ask_price),
+                 schema::make("A", &self::best_ask_qty))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#all-book-tickers-stream
 struct book_ticker_all
@@ -208,12 +216,19 @@ struct book_ticker_all
     json::value_to(jb, book_tickers);
     return *this;
   }
+  // for_each decodes the elements one by one, see json::for_each.
+  template<class F>
+  static size_t for_each(const json::array& jb, F&& f)
+  {
+    return json::for_each<book_ticker>(jb, std::forward<F>(f));
+  }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#liquidation-order-streams
 struct liq_order
 {
   time_point_t trade_time;        // T
   std::string_view symbol;        // s
+  symbol_id sym_id;               // s (interned)
   std::string_view side;          // S
   std::string_view order_type;    // o
   std::string_view order_status;  // X
@@ -222,20 +237,17 @@ struct liq_order
   double avg_price;               // ap
   double last_filled_qty;         // l
   double acc_filled;              // z
-  liq_order& operator=(const json::object& jb)
-  {
-    _value_to("T", trade_time);
-    _value_to("s", symbol);
-    _value_to("S", side);
-    _value_to("o", order_type);
-    _value_to("X", order_status);
-    _value_to("f", tif);
-    _value_to("q", qty);
-    _value_to("ap", avg_price);
-    _value_to("l", last_filled_qty);
-    _value_to("z", acc_filled);
-    return *this;
-  }
+  BINANCE_SCHEMA(liq_order,
+                 schema::make("T", &self::trade_time),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("S", &self::side),
+                 schema::make("o", &self::order_type),
+                 schema::make("X", &self::order_status),
+                 schema::make("f", &self::tif),
+                 schema::make("q", &self::qty),
+                 schema::make("ap", &self::avg_price),
+                 schema::make("l", &self::last_filled_qty),
+                 schema::make("z", &self::acc_filled))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#all-market-liquidation-order-streams
 struct liq_order_all
@@ -246,69 +258,75 @@ struct liq_order_all
     json::value_to(jv, orders, "o");
     return *this;
   }
+  // for_each decodes the elements one by one, see json::for_each.
+  template<class F>
+  static size_t for_each(const json::array& jb, F&& f)
+  {
+    return json::for_each<liq_order>(jb, "o", std::forward<F>(f));
+  }
 };
 struct price_point
 {
-  double price;
-  double qty;
-  price_point& operator=(const json::array& jr)
+  double price;  // 0
+  double qty;    // 1
+
+  BINANCE_SCHEMA_ARRAY(price_point,
+                       schema::make("price", &self::price),
+                       schema::make("qty", &self::qty))
+};
+// book_depth_header holds every field of a depth update except the price
+// levels. Decoding it and then the levels with for_each_bid/for_each_ask
+// applies an update without allocating.
+struct book_depth_header
+{
+  std::string_view event_type;  // e
+  std::string_view symbol;      // s
+  symbol_id sym_id;             // s (interned)
+  time_point_t event_time;      // E
+  time_point_t x_time;          // T
+  int64_t first_id;             // U
+  int64_t final_id;             // u
+  int64_t last_final_id;        // pu
+
+  BINANCE_SCHEMA(book_depth_header,
+                 schema::make("e", &self::event_type),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("E", &self::event_time),
+                 schema::make("T", &self::x_time),
+                 schema::make("U", &self::first_id),
+                 schema::make("u", &self::final_id),
+                 schema::make("pu", &self::last_final_id))
+
+  template<class F>
+  static size_t for_each_bid(const json::object& jb, F&& f)
   {
-    json::value_to(jr.begin(), jr.end(), price, qty);
-    return *this;
+    return json::for_each<price_point>(jb, "b", std::forward<F>(f));
+  }
+  template<class F>
+  static size_t for_each_ask(const json::object& jb, F&& f)
+  {
+    return json::for_each<price_point>(jb, "a", std::forward<F>(f));
   }
 };
 // https://binance-docs.github.io/apidocs/futures/en/#partial-book-depth-streams
-struct partial_book_depth
+struct partial_book_depth : public book_depth_header
 {
-  std::string_view event_type;    // e
-  std::string_view symbol;        // s
-  time_point_t event_time;        // E
-  time_point_t x_time;            // T
-  int64_t first_id;               // U
-  int64_t final_id;               // u
-  int64_t last_final_id;          // pu
   std::vector<price_point> bids;  // b
   std::vector<price_point> asks;  // a
-  partial_book_depth& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("s", symbol);
-    _value_to("E", event_time);
-    _value_to("T", x_time);
-    _value_to("U", first_id);
-    _value_to("u", final_id);
-    _value_to("pu", last_final_id);
-    _value_to("b", bids);
-    _value_to("a", asks);
-    return *this;
-  }
+
+  BINANCE_SCHEMA_EXTENDS(partial_book_depth, book_depth_header,
+                         schema::make("b", &self::bids),
+                         schema::make("a", &self::asks))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#diff-book-depth-streams
-struct book_depth
+struct book_depth : public book_depth_header
 {
-  std::string_view event_type;    // e
-  std::string_view symbol;        // s
-  time_point_t event_time;        // E
-  time_point_t x_time;            // T
-  int64_t first_id;               // U
-  int64_t final_id;               // u
-  int64_t last_final_id;          // pu
   std::vector<price_point> bids;  // b
   std::vector<price_point> asks;  // a
 
-  book_depth& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("s", symbol);
-    _value_to("E", event_time);
-    _value_to("T", x_time);
-    _value_to("U", first_id);
-    _value_to("u", final_id);
-    _value_to("pu", last_final_id);
-    _value_to("b", bids);
-    _value_to("a", asks);
-    return *this;
-  }
+  BINANCE_SCHEMA_EXTENDS(book_depth, book_depth_header,
+                         schema::make("b", &self::bids),
+                         schema::make("a", &self::asks))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#blvt-info-streams
 struct blvt_info
@@ -316,13 +334,11 @@ struct blvt_info
   struct basket
   {
     std::string_view symbol;  // s
+    symbol_id sym_id;         // s (interned)
     double position;          // n
-    basket& operator=(const json::object& jb)
-    {
-      _value_to("s", symbol);
-      _value_to("n", position);
-      return *this;
-    }
+    BINANCE_SCHEMA(basket,
+                   schema::make("s", &self::symbol, &self::sym_id),
+                   schema::make("n", &self::position))
   };
 
   time_point_t event_time;      // E
@@ -335,19 +351,16 @@ struct blvt_info
   double funding_ratio;         // f
   std::vector<basket> baskets;  // b
 
-  blvt_info& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("E", event_time);
-    _value_to("s", blvt_name);
-    _value_to("m", token);
-    _value_to("b", baskets);
-    _value_to("n", nav);
-    _value_to("l", leverage);
-    _value_to("t", target_leverage);
-    _value_to("f", funding_ratio);
-    return *this;
-  }
+  BINANCE_SCHEMA(blvt_info,
+                 schema::make("e", &self::event_type),
+                 schema::make("E", &self::event_time),
+                 schema::make("s", &self::blvt_name),
+                 schema::make("m", &self::token),
+                 schema::make("b", &self::baskets),
+                 schema::make("n", &self::nav),
+                 schema::make("l", &self::leverage),
+                 schema::make("t", &self::target_leverage),
+                 schema::make("f", &self::funding_ratio))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#blvt-nav-kline-candlestick-streams
 using blvt_nav_kline = kline;
@@ -356,12 +369,9 @@ struct user_data_expired
 {
   std::string_view event_type;  // e
   time_point_t event_time;      // E
-  user_data_expired& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("E", event_time);
-    return *this;
-  }
+  BINANCE_SCHEMA(user_data_expired,
+                 schema::make("e", &self::event_type),
+                 schema::make("E", &self::event_time))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#event-margin-call
 struct user_margin_call
@@ -369,6 +379,7 @@ struct user_margin_call
   struct position
   {
     std::string_view symbol;       // s
+    symbol_id sym_id;              // s (interned)
     std::string_view pos_side;     // ps
     std::string_view margin_type;  // mt
     double pos_amount;             // pa
@@ -376,32 +387,26 @@ struct user_margin_call
     double mark_price;             // mp
     double u_pnl;                  // up
     double m_margin;               // mm
-    position& operator=(const json::object& jb)
-    {
-      _value_to("s", symbol);
-      _value_to("ps", pos_side);
-      _value_to("mt", margin_type);
-      _value_to("pa", pos_amount);
-      _value_to("iw", isolated_wallet);
-      _value_to("mp", mark_price);
-      _value_to("up", u_pnl);
-      _value_to("mm", m_margin);
-      return *this;
-    }
+    BINANCE_SCHEMA(position,
+                   schema::make("s", &self::symbol, &self::sym_id),
+                   schema::make("ps", &self::pos_side),
+                   schema::make("mt", &self::margin_type),
+                   schema::make("pa", &self::pos_amount),
+                   schema::make("iw", &self::isolated_wallet),
+                   schema::make("mp", &self::mark_price),
+                   schema::make("up", &self::u_pnl),
+                   schema::make("mm", &self::m_margin))
   };
 
   std::string_view event_type;       // e
   time_point_t event_time;           // E
   double cw_balance;                 // cw
   std::vector<position> pos_margin;  // p
-  user_margin_call& operator=(const json::object& jb)
-  {
-    _value_to("e", event_type);
-    _value_to("E", event_time);
-    _value_to("cw", cw_balance);
-    _value_to("p", pos_margin);
-    return *this;
-  }
+  BINANCE_SCHEMA(user_margin_call,
+                 schema::make("e", &self::event_type),
+                 schema::make("E", &self::event_time),
+                 schema::make("cw", &self::cw_balance),
+                 schema::make("p", &self::pos_margin))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#event-balance-and-position-update
 struct user_position_update
@@ -413,17 +418,15 @@ struct user_position_update
       std::string_view asset;       // a
       double wallet_balance;        // wb
       double cross_wallet_balance;  // cw
-      balance& operator=(const json::object& jb)
-      {
-        _value_to("a", asset);
-        _value_to("wb", wallet_balance);
-        _value_to("cw", cross_wallet_balance);
-        return *this;
-      }
+      BINANCE_SCHEMA(balance,
+                     schema::make("a", &self::asset),
+                     schema::make("wb", &self::wallet_balance),
+                     schema::make("cw", &self::cross_wallet_balance))
     };
     struct position
     {
       std::string_view symbol;       // s
+      symbol_id sym_id;              // s (interned)
       std::string_view margin_type;  // mt
       std::string_view pos_side;     // ps
       double position_amount;        // pa
@@ -431,41 +434,32 @@ struct user_position_update
       double acc_realized;           // cr
       double unrealized_pnl;         // up
       double isolated_wallet;        // iw
-      position& operator=(const json::object& jb)
-      {
-        _value_to("s", symbol);
-        _value_to("mt", margin_type);
-        _value_to("ps", pos_side);
-        _value_to("pa", position_amount);
-        _value_to("ep", entry_price);
-        _value_to("cr", acc_realized);
-        _value_to("up", unrealized_pnl);
-        _value_to("iw", isolated_wallet);
-        return *this;
-      }
+      BINANCE_SCHEMA(position,
+                     schema::make("s", &self::symbol, &self::sym_id),
+                     schema::make("mt", &self::margin_type),
+                     schema::make("ps", &self::pos_side),
+                     schema::make("pa", &self::position_amount),
+                     schema::make("ep", &self::entry_price),
+                     schema::make("cr", &self::acc_realized),
+                     schema::make("up", &self::unrealized_pnl),
+                     schema::make("iw", &self::isolated_wallet))
     };
 
     std::string_view event_reason_type;  // m
     std::vector<balance> balances;       // B
     std::vector<position> positions;     // P
-    updated_data& operator=(const json::object& jb)
-    {
-      _value_to("m", event_reason_type);
-      _value_to("B", balances);
-      _value_to("P", positions);
-      return *this;
-    }
+    BINANCE_SCHEMA(updated_data,
+                   schema::make("m", &self::event_reason_type),
+                   schema::make("B", &self::balances),
+                   schema::make("P", &self::positions))
   };
   time_point_t event_time;   // E
   int64_t transaction;       // T
   updated_data update_data;  // a
-  user_position_update& operator=(const json::object& jb)
-  {
-    _value_to("E", event_time);
-    _value_to("T", transaction);
-    _value_to("a", update_data);
-    return *this;
-  }
+  BINANCE_SCHEMA(user_position_update,
+                 schema::make("E", &self::event_time),
+                 schema::make("T", &self::transaction),
+                 schema::make("a", &self::update_data))
 };
 // https://binance-docs.github.io/apidocs/futures/en/#event-order-update
 struct user_order_update
@@ -474,6 +468,7 @@ struct user_order_update
   int64_t order_id;                    // i
   int64_t trade_id;                    // t
   std::string_view symbol;             // s
+  symbol_id sym_id;                    // s (interned)
   std::string_view client_oid;         // c
   std::string_view side;               // S
   std::string_view order_type;         // o
@@ -494,48 +489,44 @@ struct user_order_update
   double comission;                    // n
   double bid_notional;                 // b
   double ask_notional;                 // a
-  double closed_all;                   // cp
-  double activation_price;             // ap
+  bool closed_all;                     // cp
+  double activation_price;             // AP
   double callback_rate;                // cr
   double realized_profit;              // rp
   bool is_maker;                       // m
   bool is_reduce_only;                 // R
-  user_order_update& operator=(const json::object& jb)
-  {
-    _value_to("T", order_time);
-    _value_to("i", order_id);
-    _value_to("t", trade_id);
-    _value_to("s", symbol);
-    _value_to("c", client_oid);
-    _value_to("S", side);
-    _value_to("o", order_type);
-    _value_to("f", time_in_force);
-    _value_to("x", exec_type);
-    _value_to("X", status);
-    _value_to("N", commission_asset);
-    _value_to("wt", stop_working_type);
-    _value_to("ot", orig_order_type);
-    _value_to("ps", pos_side);
-    _value_to("q", orig_qty);
-    _value_to("p", orig_price);
-    _value_to("ap", avg_price);
-    _value_to("sp", stop_price);
-    _value_to("l", last_filled_qty);
-    _value_to("z", acc_qty);
-    _value_to("L", last_filled_price);
-    _value_to("n", comission);
-    _value_to("b", bid_notional);
-    _value_to("a", ask_notional);
-    _value_to("cp", closed_all);
-    _value_to("ap", activation_price);
-    _value_to("cr", callback_rate);
-    _value_to("rp", realized_profit);
-    _value_to("m", is_maker);
-    _value_to("R", is_reduce_only);
-    return *this;
-  }
+  BINANCE_SCHEMA(user_order_update,
+                 schema::make("T", &self::order_time),
+                 schema::make("i", &self::order_id),
+                 schema::make("t", &self::trade_id),
+                 schema::make("s", &self::symbol, &self::sym_id),
+                 schema::make("c", &self::client_oid),
+                 schema::make("S", &self::side),
+                 schema::make("o", &self::order_type),
+                 schema::make("f", &self::time_in_force),
+                 schema::make("x", &self::exec_type),
+                 schema::make("X", &self::status),
+                 schema::make("N", &self::commission_asset),
+                 schema::make("wt", &self::stop_working_type),
+                 schema::make("ot", &self::orig_order_type),
+                 schema::make("ps", &self::pos_side),
+                 schema::make("q", &self::orig_qty),
+                 schema::make("p", &self::orig_price),
+                 schema::make("ap", &self::avg_price),
+                 schema::make("sp", &self::stop_price),
+                 schema::make("l", &self::last_filled_qty),
+                 schema::make("z", &self::acc_qty),
+                 schema::make("L", &self::last_filled_price),
+                 schema::make("n", &self::comission),
+                 schema::make("b", &self::bid_notional),
+                 schema::make("a", &self::ask_notional),
+                 schema::make("cp", &self::closed_all),
+                 schema::make("AP", &self::activation_price),
+                 schema::make("cr", &self::callback_rate),
+                 schema::make("rp", &self::realized_profit),
+                 schema::make("m", &self::is_maker),
+                 schema::make("R", &self::is_reduce_only))
 };
-#undef _value_to
 }  // namespace messages
 }  // namespace websocket
 }  // namespace binance
@@ -0,0 +1,189 @@
+#ifndef BINANCE_WEBSOCKET_PEEK_HPP
+#define BINANCE_WEBSOCKET_PEEK_HPP
+
+#include <binance/common.hpp>
+#include <binance/cpu.hpp>
+#include <binance/padded_buffer.hpp>
+#include <binance/symbols.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace binance
+{
+namespace websocket
+{
+// frame_info is what peek finds in a raw frame. Fields not found are empty.
+struct frame_info
+{
+  std::string_view stream;  // stream (combined streams only)
+  std::string_view event;   // e
+  std::string_view symbol;  // s
+};
+
+namespace detail
+{
+constexpr size_t npos = std::string_view::npos;
+
+// __find returns the position of needle (2 bytes or more) in [p, p + n), or
+// npos. Candidates are found 16 bytes at a time by comparing the first and the
+// last byte of the needle, only those are compared in full.
+really_inline size_t __find(const char* p, size_t n, std::string_view needle)
+{
+  const size_t k = needle.size();
+  if (n < k)
+    return npos;
+
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last  = _mm_set1_epi8(needle[k - 1]);
+  for (; i + k - 1 + 16 <= n; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*) (p + i));
+    __m128i b = _mm_loadu_si128((const __m128i*) (p + i + k - 1));
+    unsigned mask = unsigned(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+    while (mask != 0)
+    {
+      unsigned bit = unsigned(__builtin_ctz(mask));
+      if (std::memcmp(p + i + bit + 1, needle.data() + 1, k - 2) == 0)
+        return i + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i + k <= n; i++)
+  {
+    if (p[i] == needle[0] && std::memcmp(p + i, needle.data(), k) == 0)
+      return i;
+  }
+  return npos;
+}
+
+// __string_value returns the string following key (e.g. `"e":"`), looking for
+// the key in the first n bytes and for the closing quote up to end.
+really_inline std::string_view __string_value(const char* p, size_t n,
+                                              const char* end,
+                                              std::string_view key)
+{
+  size_t i = __find(p, n, key);
+  if (i == npos)
+    return {};
+
+  const char* s = p + i + key.size();
+  const char* e =
+      static_cast<const char*>(std::memchr(s, '"', size_t(end - s)));
+  if (e == nullptr)
+    return {};
+  return std::string_view(s, size_t(e - s));
+}
+}  // namespace detail
+
+// peek finds the event type, the symbol and, for combined streams, the stream
+// name of a raw frame without parsing it, so unwanted frames can be dropped
+// before json::parser::parse runs.
+//
+// Only the first max_scan bytes (of the payload, for combined streams) are
+// searched. Binance sends "e" and "s" before any nested object or array, so
+// the default is enough for every market stream.
+inline frame_info peek(const char* data, size_t size, size_t max_scan = 256)
+{
+  constexpr std::string_view stream_key = "{\"stream\":\"";
+
+  frame_info fi;
+  const char* end = data + size;
+  const char* p   = data;
+  if (size > stream_key.size()
+      && std::memcmp(data, stream_key.data(), stream_key.size()) == 0)
+  {
+    fi.stream = detail::__string_value(data, stream_key.size(), end,
+                                       stream_key);
+    p         = fi.stream.data() + fi.stream.size();
+  }
+
+  size_t n  = std::min(size_t(end - p), max_scan);
+  fi.event  = detail::__string_value(p, n, end, "\"e\":\"");
+  fi.symbol = detail::__string_value(p, n, end, "\"s\":\"");
+  return fi;
+}
+
+inline frame_info peek(const boost::beast::flat_buffer& buffer,
+                       size_t max_scan = 256)
+{
+  return peek(static_cast<const char*>(buffer.data().data()), buffer.size(),
+              max_scan);
+}
+
+inline frame_info peek(const padded_buffer& buffer, size_t max_scan = 256)
+{
+  return peek(static_cast<const char*>(buffer.data().data()), buffer.size(),
+              max_scan);
+}
+
+// frame_filter accepts or rejects raw frames by event type and symbol.
+//
+//   binance::websocket::frame_filter filter;
+//   filter.allow_event("depthUpdate").allow_symbol("BTCUSDT");
+//   ...
+//   if (!filter.accept(buffer_))
+//     return read();
+//   parser_.parse(buffer_);
+class frame_filter
+{
+  std::vector<std::string> events_;
+  symbol_registry symbols_;
+
+public:
+  // allow_event accepts frames of the event type. If no event is allowed,
+  // every event type is accepted.
+  frame_filter& allow_event(std::string_view e)
+  {
+    if (std::find(events_.begin(), events_.end(), e) == events_.end())
+      events_.emplace_back(e);
+    return *this;
+  }
+
+  // allow_symbol accepts frames of the symbol (as sent by the exchange, e.g.
+  // BTCUSDT). If no symbol is allowed, every symbol is accepted.
+  frame_filter& allow_symbol(std::string_view s)
+  {
+    symbols_.insert(s);
+    return *this;
+  }
+
+  // accept returns false for frames with an event type or a symbol that is
+  // not allowed. Frames without them (e.g. replies to subscribe) pass.
+  really_inline bool accept(const frame_info& fi) const
+  {
+    if (!events_.empty() && !fi.event.empty()
+        && std::find(events_.begin(), events_.end(), fi.event) == events_.end())
+      return false;
+    if (!symbols_.empty() && !fi.symbol.empty()
+        && symbols_.find(fi.symbol) == invalid_symbol)
+      return false;
+    return true;
+  }
+
+  really_inline bool accept(const char* data, size_t size) const
+  {
+    return accept(peek(data, size));
+  }
+
+  really_inline bool accept(const boost::beast::flat_buffer& buffer) const
+  {
+    return accept(peek(buffer));
+  }
+
+  really_inline bool accept(const padded_buffer& buffer) const
+  {
+    return accept(peek(buffer));
+  }
+};
+}  // namespace websocket
+}  // namespace binance
+
+#endif
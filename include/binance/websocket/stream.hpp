@@ -25,7 +25,8 @@
 
 namespace binance
 {
-using buffer = boost::beast::flat_buffer;
+// buffer keeps the padding json::parser needs to parse frames in place.
+using buffer = padded_buffer;
 
 namespace websocket
 {
@@ -47,6 +48,7 @@ class stream : public std::enable_shared_from_this<stream>
 #endif
   uint64_t id_;
   time_point_t connected_at_;
+  std::function<void(const binance::error&)> on_error_;
 
 public:
   // connect_handler will be called when the connection is successfully
@@ -57,6 +59,8 @@ public:
   using connect_handler =
       std::function<void(std::shared_ptr<stream>, binance::error)>;
 #endif
+  // error_handler is called when a message can't be sent.
+  using error_handler = std::function<void(const binance::error&)>;
 
   stream()               = delete;
   stream(const stream&)  = delete;
@@ -83,6 +87,7 @@ public:
   // the websocket connection to the user data streams
   // using the listen_key.
   void async_connect(const std::string& listen_key, connect_handler);
+  void set_error_handler(error_handler);
   // returns true if the stream is open, false otherwise
   really_inline operator bool() const;
   void subscribe(const std::vector<std::string>&);
@@ -149,6 +154,11 @@ stream::~stream()
     close();
 }
 
+void stream::set_error_handler(stream::error_handler h)
+{
+  on_error_ = std::move(h);
+}
+
 uint64_t stream::id() const
 {
   return id_;
@@ -384,6 +394,7 @@ void stream::on_ws_handshake(stream::connect_handler cb, std::string host,
 
 #ifdef BINANCE_WEBSOCKET_QUEUE_MESSAGES
   connected_ = true;
+  next_async_message();
 #endif
 
   stream_->control_callback(
@@ -473,7 +484,14 @@ void stream::on_message_sent(const boost::system::error_code& ec, size_t n)
 #ifdef BINANCE_DEBUG
     std::cout << "error writing message: " << ec << std::endl;
 #endif
-    throw binance::error{ec};
+#ifdef BINANCE_WEBSOCKET_QUEUE_MESSAGES
+    // the messages left are sent once connected again.
+    messages_.pop();
+    connected_ = false;
+#endif
+    if (on_error_)
+      on_error_(ec);
+    return;
   }
 
 #ifdef BINANCE_WEBSOCKET_QUEUE_MESSAGES
@@ -0,0 +1,485 @@
+#ifndef BINANCE_WIRE_HPP
+#define BINANCE_WIRE_HPP
+
+#include <binance/common.hpp>
+#include <binance/schema.hpp>
+#include <binance/symbols.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// wire is a fixed-offset binary encoding of the schema messages, meant to
+// forward decoded market data between processes.
+//
+// A frame is a header followed by the message. The message starts with a
+// record holding one slot per field, in schema order, so every field lives at
+// an offset known at compile time and can be read in place with wire::view.
+// Slots (native byte order):
+//
+//   double             double, bit exact
+//   int64_t            int64_t
+//   time_point_t       int64_t tick count
+//   int                int32_t
+//   bool               uint8_t
+//   interned symbol    uint32_t symbol_id, then a string
+//   strings            uint32_t offset, uint32_t size
+//   vectors            uint32_t offset, uint32_t count
+//   nested messages    their own record, inline
+//
+// Offsets point after the record, from the start of the message, where the
+// string bytes and vector records are stored.
+//
+// Symbols are sent as symbol_ids, so both ends must install a symbol_registry
+// built from the same list (e.g. the same exchange_info response): the header
+// carries the fingerprint of the registry and frames from another one are not
+// opened. Symbols without an id are sent as strings.
+namespace binance
+{
+namespace wire
+{
+constexpr uint16_t magic   = 0x4e42;  // BN
+constexpr uint16_t version = 2;
+
+struct header
+{
+  uint16_t magic;
+  uint16_t version;
+  uint32_t fingerprint;  // of the schema, see fingerprint<T>()
+  uint32_t symbols;      // of the symbol_registry, 0 if none
+  uint32_t size;         // of the message, without the header
+};
+
+template<class T>
+constexpr size_t record_size();
+
+namespace detail
+{
+template<class FD>
+constexpr size_t __slot_size()
+{
+  using M = typename FD::member_type;
+  if constexpr (schema::is_interned<FD>::value)
+    return 3 * sizeof(uint32_t);
+  else if constexpr (std::is_same_v<M, bool>)
+    return sizeof(uint8_t);
+  else if constexpr (std::is_same_v<M, int>)
+    return sizeof(int32_t);
+  else if constexpr (std::is_arithmetic_v<M> || std::is_same_v<M, time_point_t>)
+    return sizeof(int64_t);
+  else if constexpr (std::is_convertible_v<const M&, std::string_view>
+                     || schema::is_vector<M>::value)
+    return 2 * sizeof(uint32_t);
+  else
+    return record_size<M>();
+}
+
+template<class T, size_t... I>
+constexpr size_t __sum_slots(std::index_sequence<I...>)
+{
+  using fields_t = decltype(T::fields());
+  return (size_t(0) + ... + __slot_size<std::tuple_element_t<I, fields_t>>());
+}
+
+template<class T, size_t I>
+constexpr size_t __offset()
+{
+  return __sum_slots<T>(std::make_index_sequence<I>{});
+}
+
+template<class T>
+constexpr size_t __field_count()
+{
+  return std::tuple_size_v<decltype(T::fields())>;
+}
+
+// calls f(field, offset) for every field of T.
+template<class T, class F, size_t... I>
+really_inline void __for_each_slot(F&& f, std::index_sequence<I...>)
+{
+  constexpr auto fs = T::fields();
+  (f(std::get<I>(fs), std::integral_constant<size_t, __offset<T, I>()>{}),
+   ...);
+}
+
+template<class T, class F>
+really_inline void __for_each_slot(F&& f)
+{
+  __for_each_slot<T>(f, std::make_index_sequence<__field_count<T>()>{});
+}
+
+template<class V>
+really_inline void __put(std::string& out, size_t pos, V v)
+{
+  std::memcpy(&out[pos], &v, sizeof(V));
+}
+
+template<class V>
+really_inline V __get(const char* p)
+{
+  V v;
+  std::memcpy(&v, p, sizeof(V));
+  return v;
+}
+
+really_inline uint32_t __fnv(uint32_t h, const char* s, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ uint8_t(s[i])) * 16777619u;
+  return h;
+}
+
+really_inline uint32_t __symbols_fingerprint()
+{
+  const symbol_registry* r = installed_symbols();
+  return r ? r->fingerprint() : 0;
+}
+
+really_inline void __put_string(std::string& out, size_t base, size_t at,
+                                std::string_view s)
+{
+  __put(out, at, uint32_t(out.size() - base));
+  __put(out, at + 4, uint32_t(s.size()));
+  out.append(s.data(), s.size());
+}
+}  // namespace detail
+
+// record_size returns the size of the fixed part of T.
+template<class T>
+constexpr size_t record_size()
+{
+  return detail::__sum_slots<T>(
+      std::make_index_sequence<detail::__field_count<T>()>{});
+}
+
+// fingerprint identifies the layout of T: its keys, slots and nested types.
+template<class T>
+uint32_t fingerprint()
+{
+  static const uint32_t h = [] {
+    uint32_t v = 2166136261u;
+    schema::for_each_field<T>([&](const auto& fd) {
+      using FD = std::decay_t<decltype(fd)>;
+      using M  = typename FD::member_type;
+      uint32_t slot = uint32_t(detail::__slot_size<FD>());
+      v = detail::__fnv(v, fd.key, std::strlen(fd.key) + 1);
+      v = detail::__fnv(v, reinterpret_cast<const char*>(&slot), sizeof(slot));
+      if constexpr (schema::is_vector<M>::value)
+      {
+        uint32_t e = fingerprint<typename M::value_type>();
+        v          = detail::__fnv(v, reinterpret_cast<const char*>(&e), 4);
+      }
+      else if constexpr (schema::has_fields<M>::value)
+      {
+        uint32_t e = fingerprint<M>();
+        v          = detail::__fnv(v, reinterpret_cast<const char*>(&e), 4);
+      }
+    });
+    return v;
+  }();
+  return h;
+}
+
+namespace detail
+{
+// __encode writes the record of v at out[pos] and appends its strings and
+// vectors to out. base is where the message starts.
+template<class T>
+void __encode(const T& v, std::string& out, size_t base, size_t pos)
+{
+  __for_each_slot<T>([&](const auto& fd, auto off) {
+    using FD        = std::decay_t<decltype(fd)>;
+    using M         = typename FD::member_type;
+    const M& m      = v.*fd.member;
+    const size_t at = pos + decltype(off)::value;
+
+    if constexpr (schema::is_interned<FD>::value)
+    {
+      // the name only goes along when the id can't be resolved.
+      symbol_id id = v.*fd.id;
+      __put(out, at, uint32_t(id));
+      __put_string(out, base, at + 4,
+                   id == invalid_symbol ? std::string_view(m)
+                                        : std::string_view());
+    }
+    else if constexpr (std::is_same_v<M, bool>)
+      __put(out, at, uint8_t(m));
+    else if constexpr (std::is_same_v<M, int>)
+      __put(out, at, int32_t(m));
+    else if constexpr (std::is_floating_point_v<M>)
+      __put(out, at, double(m));
+    else if constexpr (std::is_arithmetic_v<M>)
+      __put(out, at, int64_t(m));
+    else if constexpr (std::is_same_v<M, time_point_t>)
+      __put(out, at, int64_t(m.time_since_epoch().count()));
+    else if constexpr (std::is_convertible_v<const M&, std::string_view>)
+      __put_string(out, base, at, m);
+    else if constexpr (schema::is_vector<M>::value)
+    {
+      using E         = typename M::value_type;
+      const size_t rs = record_size<E>();
+      const size_t first = out.size();
+      __put(out, at, uint32_t(first - base));
+      __put(out, at + 4, uint32_t(m.size()));
+      out.resize(first + rs * m.size());
+      for (size_t i = 0; i < m.size(); i++)
+        __encode(m[i], out, base, first + i * rs);
+    }
+    else
+      __encode(m, out, base, at);
+  });
+}
+}  // namespace detail
+
+// encode appends the frame of v to out and returns its size.
+template<class T>
+size_t encode(const T& v, std::string& out)
+{
+  const size_t start = out.size();
+  const size_t base  = start + sizeof(header);
+  out.resize(base + record_size<T>());
+  detail::__encode(v, out, base, base);
+
+  header h{magic, version, fingerprint<T>(), detail::__symbols_fingerprint(),
+           uint32_t(out.size() - base)};
+  std::memcpy(&out[start], &h, sizeof(h));
+  return out.size() - start;
+}
+
+// frame_size returns the size of the frame at data, header included, or 0 if
+// data doesn't hold a whole frame. Used to walk a buffer of frames.
+inline size_t frame_size(const char* data, size_t size)
+{
+  if (size < sizeof(header))
+    return 0;
+  header h = detail::__get<header>(data);
+  if (h.magic != magic || size - sizeof(header) < h.size)
+    return 0;
+  return sizeof(header) + h.size;
+}
+
+template<class T>
+class view;
+
+// list is a vector field read in place.
+template<class E>
+class list
+{
+  const char* base_;
+  size_t size_;
+  const char* first_;
+  size_t count_;
+
+public:
+  list()
+      : base_(nullptr)
+      , size_(0)
+      , first_(nullptr)
+      , count_(0)
+  {
+  }
+  list(const char* base, size_t size, const char* first, size_t count)
+      : base_(base)
+      , size_(size)
+      , first_(first)
+      , count_(count)
+  {
+  }
+  size_t size() const
+  {
+    return count_;
+  }
+  bool empty() const
+  {
+    return count_ == 0;
+  }
+  view<E> operator[](size_t i) const
+  {
+    return view<E>(base_, size_, first_ + i * record_size<E>());
+  }
+};
+
+namespace detail
+{
+template<class M>
+struct __result
+{
+  using type = M;
+};
+template<>
+struct __result<std::string>
+{
+  using type = std::string_view;
+};
+template<class E>
+struct __result<std::vector<E>>
+{
+  using type = list<E>;
+};
+}  // namespace detail
+
+// view reads the fields of a message in place, without decoding it:
+//
+//   auto v = binance::wire::open<book_ticker>(data, size);
+//   if (v && v.get(&book_ticker::sym_id) == btcusdt)
+//     price = v.get(&book_ticker::best_bid_price);
+//
+// Strings are views of the frame; interned symbols are read from the
+// installed symbol_registry, or from the frame if they had no id.
+template<class T>
+class view
+{
+  const char* base_;  // message
+  size_t size_;
+  const char* rec_;  // record of this T
+
+public:
+  view()
+      : base_(nullptr)
+      , size_(0)
+      , rec_(nullptr)
+  {
+  }
+  view(const char* base, size_t size, const char* rec)
+      : base_(base)
+      , size_(size)
+      , rec_(rec)
+  {
+  }
+
+  explicit operator bool() const
+  {
+    return rec_ != nullptr;
+  }
+
+  // get returns the field pointed by member. Nested messages are returned as
+  // a view and vectors as a list.
+  template<class M, class C>
+  really_inline auto get(M C::*member) const
+  {
+    using R = std::conditional_t<schema::has_fields<M>::value, view<M>,
+                                 typename detail::__result<M>::type>;
+    R r{};
+    detail::__for_each_slot<T>([&](const auto& fd, auto off) {
+      using FD = std::decay_t<decltype(fd)>;
+      if constexpr (std::is_same_v<typename FD::member_type, M>)
+      {
+        if (static_cast<M T::*>(fd.member) == static_cast<M T::*>(member))
+          r = read<FD>(decltype(off)::value);
+      }
+      if constexpr (schema::is_interned<FD>::value
+                    && std::is_same_v<M, symbol_id>)
+      {
+        if (static_cast<M T::*>(fd.id) == static_cast<M T::*>(member))
+          r = detail::__get<uint32_t>(rec_ + decltype(off)::value);
+      }
+    });
+    return r;
+  }
+
+  // decode copies every field into v. Strings point into the frame.
+  void decode(T& v) const
+  {
+    detail::__for_each_slot<T>([&](const auto& fd, auto off) {
+      using FD = std::decay_t<decltype(fd)>;
+      using M  = typename FD::member_type;
+      M& m     = v.*fd.member;
+      auto r   = read<FD>(decltype(off)::value);
+
+      if constexpr (schema::is_interned<FD>::value)
+      {
+        symbol_id id = detail::__get<uint32_t>(rec_ + decltype(off)::value);
+        m            = M(r);
+        v.*fd.id     = id != invalid_symbol ? id : symbol_of(r);
+      }
+      else if constexpr (schema::is_vector<M>::value)
+      {
+        m.resize(r.size());
+        for (size_t i = 0; i < r.size(); i++)
+          r[i].decode(m[i]);
+      }
+      else if constexpr (schema::has_fields<M>::value)
+        r.decode(m);
+      else
+        m = M(r);
+    });
+  }
+
+private:
+  template<class FD>
+  really_inline auto read(size_t off) const
+  {
+    using M       = typename FD::member_type;
+    const char* p = rec_ + off;
+
+    if constexpr (schema::is_interned<FD>::value)
+    {
+      symbol_id id             = detail::__get<uint32_t>(p);
+      const symbol_registry* r = installed_symbols();
+      if (id == invalid_symbol || r == nullptr || id >= r->size())
+        return string_at(p + 4);
+      return std::string_view(r->name(id));
+    }
+    else if constexpr (std::is_same_v<M, bool>)
+      return detail::__get<uint8_t>(p) != 0;
+    else if constexpr (std::is_same_v<M, int>)
+      return int(detail::__get<int32_t>(p));
+    else if constexpr (std::is_floating_point_v<M>)
+      return M(detail::__get<double>(p));
+    else if constexpr (std::is_arithmetic_v<M>)
+      return M(detail::__get<int64_t>(p));
+    else if constexpr (std::is_same_v<M, time_point_t>)
+      return time_point_t(time_point_t::duration(detail::__get<int64_t>(p)));
+    else if constexpr (std::is_convertible_v<const M&, std::string_view>)
+      return string_at(p);
+    else if constexpr (schema::is_vector<M>::value)
+    {
+      using E     = typename M::value_type;
+      uint32_t at = detail::__get<uint32_t>(p);
+      uint32_t n  = detail::__get<uint32_t>(p + 4);
+      if (size_t(at) + size_t(n) * record_size<E>() > size_)
+        return list<E>();
+      return list<E>(base_, size_, base_ + at, n);
+    }
+    else
+      return view<M>(base_, size_, p);
+  }
+
+  really_inline std::string_view string_at(const char* p) const
+  {
+    uint32_t at = detail::__get<uint32_t>(p);
+    uint32_t n  = detail::__get<uint32_t>(p + 4);
+    if (size_t(at) + n > size_)
+      return std::string_view();
+    return std::string_view(base_ + at, n);
+  }
+};
+
+// open returns a view of the frame at data, or an empty view if the frame
+// is truncated, was encoded from another layout of T or with another
+// symbol_registry.
+template<class T>
+view<T> open(const char* data, size_t size)
+{
+  if (frame_size(data, size) == 0)
+    return view<T>();
+
+  header h = detail::__get<header>(data);
+  if (h.version != version || h.fingerprint != fingerprint<T>()
+      || h.size < record_size<T>())
+    return view<T>();
+  if (h.symbols != 0 && h.symbols != detail::__symbols_fingerprint())
+    return view<T>();
+
+  const char* base = data + sizeof(header);
+  return view<T>(base, h.size, base);
+}
+}  // namespace wire
+}  // namespace binance
+
+#endif